@@ -0,0 +1,24 @@
+#include "build_key.h"
+#include <git2.h>
+
+using json = nlohmann::json;
+using namespace lisa::server;
+
+json lisa::server::canonical_build_config(const json& config) {
+    json canonical = json::object();
+    for (const char* field : {"build", "environment", "compiler"}) {
+        canonical[field] = config.contains(field) ? config[field] : json();
+    }
+    return canonical;
+}
+
+std::string lisa::server::json_hash(const json& value) {
+    // nlohmann::json 对象按键排序，dump 结果即为规范形式
+    std::string text = value.dump();
+
+    git_oid oid;
+    git_odb_hash(&oid, text.data(), text.size(), GIT_OBJECT_BLOB);
+    char hex[GIT_OID_HEXSZ + 1];
+    git_oid_tostr(hex, sizeof(hex), &oid);
+    return hex;
+}
@@ -0,0 +1,18 @@
+#ifndef BUILD_KEY_H
+#define BUILD_KEY_H
+
+#include <string>
+#include <nlohmann/json.hpp>
+
+namespace lisa::server {
+
+// 规范化的构建配置：只保留影响构建结果的字段（构建命令、环境变量、编译器）。
+// 结果缓存和热目录的键都由它得到，改变参与的字段时两者保持一致
+nlohmann::json canonical_build_config(const nlohmann::json& config);
+
+// JSON 值的哈希（十六进制），对象按键排序，相同内容得到相同的哈希
+std::string json_hash(const nlohmann::json& value);
+
+} // namespace lisa::server
+
+#endif // BUILD_KEY_H
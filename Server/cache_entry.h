@@ -0,0 +1,18 @@
+#ifndef CACHE_ENTRY_H
+#define CACHE_ENTRY_H
+
+#include <string>
+#include <ctime>
+
+namespace lisa::server {
+
+// 缓存目录中的一个可淘汰条目（仓库镜像、检出目录或构建目录）
+struct CacheEntry {
+    std::string path;     // 条目所在目录
+    time_t last_used;     // 最后使用时间，用于LRU排序
+    bool in_use;          // 被活动任务使用时不可淘汰
+};
+
+} // namespace lisa::server
+
+#endif // CACHE_ENTRY_H
@@ -0,0 +1,176 @@
+#include "cache_manager.h"
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+
+namespace fs = std::filesystem;
+using namespace lisa::server;
+
+CacheManager::CacheManager(const Config& config, GitHandler& git_handler, CompilationHandler& compilation_handler,
+                           ResultCache& result_cache, CompilerCache& compiler_cache)
+    : git_handler_(git_handler),
+      compilation_handler_(compilation_handler),
+      result_cache_(result_cache),
+      compiler_cache_(compiler_cache),
+      interval_seconds_(config.janitor_interval_seconds()),
+      job_expiration_seconds_(config.job_expiration_seconds()),
+      repo_cache_expiration_seconds_(config.repo_cache_expiration_seconds()),
+      stop_(false) {
+    directories_.push_back({
+        "repos",
+        config.repo_cache_quota_bytes(),
+        [this]() { return git_handler_.cache_entries(compilation_handler_.active_repo_paths()); },
+        [this](const CacheEntry& entry) {
+            return git_handler_.evict(entry.path, entry.last_used, compilation_handler_.active_repo_paths());
+        },
+        {}
+    });
+    directories_.push_back({
+        "builds",
+        config.build_cache_quota_bytes(),
+        [this]() { return compilation_handler_.cache_entries(); },
+        [this](const CacheEntry& entry) { return compilation_handler_.evict(entry.path); },
+        {}
+    });
+    directories_.push_back({
+        "results",
+        config.result_cache_quota_bytes(),
+        [this]() { return result_cache_.cache_entries(); },
+        [this](const CacheEntry& entry) { return result_cache_.evict(entry.path); },
+        {}
+    });
+    directories_.push_back({
+        "compiler",
+        config.compiler_cache_quota_bytes(),
+        [this]() { return compiler_cache_.cache_entries(); },
+        [this](const CacheEntry& entry) { return compiler_cache_.evict(entry.path); },
+        {}
+    });
+
+    if (interval_seconds_ > 0) {
+        janitor_thread_ = std::thread(&CacheManager::janitor_thread, this);
+    }
+}
+
+CacheManager::~CacheManager() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        stop_ = true;
+    }
+    stop_condition_.notify_all();
+
+    if (janitor_thread_.joinable()) {
+        janitor_thread_.join();
+    }
+}
+
+std::vector<CacheUsage> CacheManager::usage() {
+    std::lock_guard<std::mutex> lock(usage_mutex_);
+    return usage_;
+}
+
+void CacheManager::janitor_thread() {
+    std::unique_lock<std::mutex> lock(stop_mutex_);
+    while (!stop_condition_.wait_for(lock, std::chrono::seconds(interval_seconds_), [this] { return stop_; })) {
+        lock.unlock();
+        try {
+            run_once();
+        } catch (const std::exception& e) {
+            Logger::error("Cache janitor failed: " + std::string(e.what()));
+        }
+        lock.lock();
+    }
+}
+
+void CacheManager::run_once() {
+    // 先按过期时间清理，再检查字节配额
+    compilation_handler_.clean_expired_jobs(job_expiration_seconds_);
+    git_handler_.clean_expired_repos(repo_cache_expiration_seconds_, compilation_handler_.active_repo_paths());
+
+    std::vector<CacheUsage> usage;
+    for (auto& directory : directories_) {
+        usage.push_back(enforce_quota(directory));
+    }
+
+    std::lock_guard<std::mutex> lock(usage_mutex_);
+    usage_ = std::move(usage);
+}
+
+CacheUsage CacheManager::enforce_quota(ManagedDirectory& directory) {
+    std::vector<CacheEntry> entries = directory.list_entries();
+
+    // 丢弃已不在列表中的条目的测量记录
+    std::unordered_map<std::string, SizeRecord> sizes;
+    for (const auto& entry : entries) {
+        auto it = directory.sizes.find(entry.path);
+        if (it != directory.sizes.end()) {
+            sizes.insert(*it);
+        }
+    }
+    directory.sizes = std::move(sizes);
+
+    uint64_t total = 0;
+    std::vector<std::pair<CacheEntry, uint64_t>> candidates;
+    time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    for (const auto& entry : entries) {
+        uint64_t bytes = entry_size(directory, entry);
+        total += bytes;
+        if (!entry.in_use && now - entry.last_used >= kMinEvictableAge && bytes > 0) {
+            candidates.emplace_back(entry, bytes);
+        }
+    }
+
+    if (directory.quota_bytes > 0 && total > directory.quota_bytes) {
+        // 最久未使用的条目优先淘汰
+        std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+            return a.first.last_used < b.first.last_used;
+        });
+
+        for (const auto& candidate : candidates) {
+            if (total <= directory.quota_bytes) break;
+            if (!directory.evict(candidate.first)) continue;
+
+            Logger::info("Evicted " + candidate.first.path + " (" + std::to_string(candidate.second) + " bytes) from " +
+                         directory.name + " cache");
+            total -= candidate.second;
+            directory.sizes.erase(candidate.first.path);
+        }
+
+        if (total > directory.quota_bytes) {
+            Logger::warn("Cache " + directory.name + " is over quota (" + std::to_string(total) + " > " +
+                         std::to_string(directory.quota_bytes) + " bytes), remaining entries are in use");
+        }
+    }
+
+    return {directory.name, total, directory.quota_bytes, entries.size()};
+}
+
+uint64_t CacheManager::entry_size(ManagedDirectory& directory, const CacheEntry& entry) {
+    // 使用中的条目持续变化，每轮重新测量；其余条目在最后使用时间变化后才重新测量
+    auto it = directory.sizes.find(entry.path);
+    if (it != directory.sizes.end() && !entry.in_use && it->second.measured_for == entry.last_used) {
+        return it->second.bytes;
+    }
+
+    uint64_t bytes = directory_size(entry.path);
+    directory.sizes[entry.path] = {bytes, entry.last_used};
+    return bytes;
+}
+
+uint64_t CacheManager::directory_size(const std::string& path) {
+    std::error_code ec;
+    uint64_t bytes = 0;
+
+    // 目录可能正在被删除或写入，逐项忽略错误
+    for (fs::recursive_directory_iterator it(path, fs::directory_options::skip_permission_denied, ec), end;
+         !ec && it != end; it.increment(ec)) {
+        std::error_code entry_ec;
+        if (it->is_regular_file(entry_ec) && !it->is_symlink(entry_ec)) {
+            uint64_t size = it->file_size(entry_ec);
+            if (!entry_ec) {
+                bytes += size;
+            }
+        }
+    }
+    return bytes;
+}
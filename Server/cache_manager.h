@@ -0,0 +1,94 @@
+#ifndef CACHE_MANAGER_H
+#define CACHE_MANAGER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "config.h"
+#include "git_handler.h"
+#include "compilation_handler.h"
+#include "result_cache.h"
+#include "compiler_cache.h"
+#include "logger.h"
+
+namespace lisa::server {
+
+// 单个缓存目录的占用情况
+struct CacheUsage {
+    std::string name;
+    uint64_t bytes;
+    uint64_t quota_bytes;   // 0 表示不限制
+    size_t entries;
+};
+
+// 缓存管理器：后台清理线程按过期时间和字节配额淘汰仓库缓存、构建目录、构建结果缓存与编译器输出缓存
+class CacheManager {
+public:
+    CacheManager(const Config& config, GitHandler& git_handler, CompilationHandler& compilation_handler,
+                 ResultCache& result_cache, CompilerCache& compiler_cache);
+    ~CacheManager();
+
+    // 禁止拷贝构造和赋值
+    CacheManager(const CacheManager&) = delete;
+    CacheManager& operator=(const CacheManager&) = delete;
+
+    // 获取最近一轮统计的缓存占用
+    std::vector<CacheUsage> usage();
+
+private:
+    // 新建的条目在该时间内不淘汰，覆盖检出目录交给任务之前的空窗
+    static constexpr time_t kMinEvictableAge = 60;
+
+    // 条目大小的测量结果
+    struct SizeRecord {
+        uint64_t bytes;
+        time_t measured_for;   // 测量时条目的最后使用时间，变化后重新测量
+    };
+
+    // 受管理的缓存目录
+    struct ManagedDirectory {
+        std::string name;
+        uint64_t quota_bytes;
+        std::function<std::vector<CacheEntry>()> list_entries;
+        std::function<bool(const CacheEntry&)> evict;   // 传入列出时的条目，实现方可据此判断是否已被重新使用
+        std::unordered_map<std::string, SizeRecord> sizes;   // 仅由清理线程访问
+    };
+
+    GitHandler& git_handler_;
+    CompilationHandler& compilation_handler_;
+    ResultCache& result_cache_;
+    CompilerCache& compiler_cache_;
+    time_t interval_seconds_;
+    time_t job_expiration_seconds_;
+    time_t repo_cache_expiration_seconds_;
+    std::vector<ManagedDirectory> directories_;
+    std::vector<CacheUsage> usage_;
+    std::mutex usage_mutex_;
+    std::thread janitor_thread_;
+    std::mutex stop_mutex_;
+    std::condition_variable stop_condition_;
+    bool stop_;
+
+    // 清理线程函数
+    void janitor_thread();
+
+    // 执行一轮清理
+    void run_once();
+
+    // 按LRU淘汰超出配额的条目，返回该目录的占用情况
+    CacheUsage enforce_quota(ManagedDirectory& directory);
+
+    // 获取条目大小，必要时重新测量
+    static uint64_t entry_size(ManagedDirectory& directory, const CacheEntry& entry);
+
+    // 统计目录占用的字节数
+    static uint64_t directory_size(const std::string& path);
+};
+
+} // namespace lisa::server
+
+#endif // CACHE_MANAGER_H
@@ -0,0 +1,228 @@
+#include "cgroup_manager.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+
+using namespace lisa::server;
+
+namespace {
+
+const char* const kCgroupMount = "/sys/fs/cgroup";
+const char* const kJobPrefix = "job-";
+
+// 删除 cgroup 时等待其中进程退出的最长时间
+constexpr int kRemoveAttempts = 100;
+constexpr auto kRemoveRetryInterval = std::chrono::milliseconds(10);
+
+// 读取 cgroup 接口文件，不存在时返回空
+std::string read_file(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return "";
+    }
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// 写入 cgroup 接口文件，失败时保留 errno
+bool write_file(const std::string& path, const std::string& value) {
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t n = write(fd, value.data(), value.size());
+    int write_errno = errno;
+    close(fd);
+    errno = write_errno;
+    return n == static_cast<ssize_t>(value.size());
+}
+
+// 读取 "key value" 形式的字段，不存在时返回0
+uint64_t read_key(const std::string& content, const std::string& key) {
+    std::istringstream lines(content);
+    std::string name;
+    uint64_t value = 0;
+    while (lines >> name >> value) {
+        if (name == key) {
+            return value;
+        }
+    }
+    return 0;
+}
+
+// 服务器进程所在的 cgroup 目录，/proc/self/cgroup 中 cgroup v2 的行形如 0::/system.slice/lisa.service
+std::string own_cgroup() {
+    std::istringstream lines(read_file("/proc/self/cgroup"));
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.compare(0, 3, "0::") == 0) {
+            std::string path = kCgroupMount + line.substr(3);
+            while (path.size() > 1 && path.back() == '/') {
+                path.pop_back();
+            }
+            return path;
+        }
+    }
+    throw std::runtime_error("Server process is not in a cgroup v2 hierarchy");
+}
+
+} // namespace
+
+CgroupManager::CgroupManager(const std::string& root) : root_(root.empty() ? own_cgroup() : root) {
+    while (root_.size() > 1 && root_.back() == '/') {
+        root_.pop_back();
+    }
+
+    struct statfs fs_info;
+    if (statfs(root_.c_str(), &fs_info) != 0 || fs_info.f_type != CGROUP2_SUPER_MAGIC) {
+        throw std::runtime_error("Not a cgroup v2 directory: " + root_);
+    }
+
+    // 有进程的 cgroup 不能向子组启用控制器，服务器进程先移入叶子组
+    if (root_ == own_cgroup()) {
+        std::string server_path = root_ + "/server";
+        if ((mkdir(server_path.c_str(), 0755) != 0 && errno != EEXIST) ||
+            !write_file(server_path + "/cgroup.procs", std::to_string(getpid()))) {
+            throw std::runtime_error("Failed to move server into " + server_path + ": " + std::strerror(errno));
+        }
+    }
+
+    // 清理上次运行残留的任务 cgroup
+    if (DIR* dir = opendir(root_.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            if (std::strncmp(entry->d_name, kJobPrefix, std::strlen(kJobPrefix)) == 0) {
+                destroy(root_ + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+
+    std::istringstream available(read_file(root_ + "/cgroup.controllers"));
+    std::vector<std::string> names{std::istream_iterator<std::string>(available), std::istream_iterator<std::string>()};
+    for (const char* controller : {"cpu", "memory", "pids", "io"}) {
+        if (std::find(names.begin(), names.end(), controller) != names.end() &&
+            write_file(root_ + "/cgroup.subtree_control", std::string("+") + controller)) {
+            controllers_.push_back(controller);
+        } else {
+            Logger::warn("cgroup controller " + std::string(controller) + " is not available under " + root_ +
+                         ", its limits and usage are not applied");
+        }
+    }
+    Logger::info("Builds run in cgroups under " + root_);
+}
+
+std::string CgroupManager::job_path(const std::string& job_id) const {
+    return root_ + "/" + kJobPrefix + job_id;
+}
+
+bool CgroupManager::has_controller(const std::string& name) const {
+    return std::find(controllers_.begin(), controllers_.end(), name) != controllers_.end();
+}
+
+int CgroupManager::create(const std::string& job_id, const ResourceLimits& limits) {
+    std::string path = job_path(job_id);
+    destroy(path);
+    if (mkdir(path.c_str(), 0755) != 0) {
+        throw std::runtime_error("Failed to create cgroup " + path + ": " + std::strerror(errno));
+    }
+
+    auto set = [&path](const std::string& file, const std::string& value) {
+        if (!write_file(path + "/" + file, value)) {
+            int set_errno = errno;
+            rmdir(path.c_str());
+            throw std::runtime_error("Failed to set " + file + " of cgroup " + path + ": " + std::strerror(set_errno));
+        }
+    };
+
+    if (limits.cpus > 0 && has_controller("cpu")) {
+        auto quota = std::max<uint64_t>(1000, static_cast<uint64_t>(limits.cpus * kCpuPeriodMicros));
+        set("cpu.max", std::to_string(quota) + " " + std::to_string(kCpuPeriodMicros));
+    }
+    if (has_controller("memory")) {
+        // 内存耗尽时整个构建一起终止，不留下半个构建继续运行
+        set("memory.oom.group", "1");
+        if (limits.memory_bytes > 0) {
+            set("memory.max", std::to_string(limits.memory_bytes));
+            // 没有交换分区时该文件不存在
+            write_file(path + "/memory.swap.max", "0");
+        }
+    }
+    if (limits.pids > 0 && has_controller("pids")) {
+        set("pids.max", std::to_string(limits.pids));
+    }
+
+    int fd = open((path + "/cgroup.procs").c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        int open_errno = errno;
+        rmdir(path.c_str());
+        throw std::runtime_error("Failed to open cgroup " + path + ": " + std::strerror(open_errno));
+    }
+    return fd;
+}
+
+ResourceUsage CgroupManager::usage(const std::string& job_id) const {
+    std::string path = job_path(job_id);
+    ResourceUsage usage;
+
+    std::istringstream(read_file(path + "/memory.peak")) >> usage.memory_peak_bytes;
+    usage.cpu_seconds = static_cast<double>(read_key(read_file(path + "/cpu.stat"), "usage_usec")) / 1e6;
+    usage.oom_kills = read_key(read_file(path + "/memory.events"), "oom_kill");
+
+    // io.stat 每行一个设备：8:0 rbytes=... wbytes=... rios=... wios=...
+    std::istringstream lines(read_file(path + "/io.stat"));
+    std::string field;
+    while (lines >> field) {
+        if (field.compare(0, 7, "rbytes=") == 0) {
+            usage.io_read_bytes += std::stoull(field.substr(7));
+        } else if (field.compare(0, 7, "wbytes=") == 0) {
+            usage.io_write_bytes += std::stoull(field.substr(7));
+        }
+    }
+    return usage;
+}
+
+ResourceUsage CgroupManager::remove(const std::string& job_id) {
+    ResourceUsage result = usage(job_id);
+    destroy(job_path(job_id));
+    return result;
+}
+
+void CgroupManager::destroy(const std::string& path) {
+    if (access(path.c_str(), F_OK) != 0) {
+        return;
+    }
+
+    // 构建进程组之外的后代（如转入后台的进程）也在 cgroup 中，删除前全部终止
+    bool kill_file = write_file(path + "/cgroup.kill", "1");
+    for (int attempt = 0; attempt < kRemoveAttempts; ++attempt) {
+        if (!kill_file) {
+            // cgroup.kill 需要 5.14 及以上的内核，否则逐个终止
+            std::istringstream procs(read_file(path + "/cgroup.procs"));
+            pid_t pid;
+            while (procs >> pid) {
+                kill(pid, SIGKILL);
+            }
+        }
+        if (rmdir(path.c_str()) == 0 || errno == ENOENT) {
+            return;
+        }
+        if (errno != EBUSY) {
+            break;
+        }
+        std::this_thread::sleep_for(kRemoveRetryInterval);
+    }
+    Logger::warn("Failed to remove cgroup " + path + ": " + std::strerror(errno));
+}
@@ -0,0 +1,69 @@
+#ifndef CGROUP_MANAGER_H
+#define CGROUP_MANAGER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace lisa::server {
+
+// 构建的资源上限，0 表示不限制
+struct ResourceLimits {
+    double cpus = 0;            // CPU时间上限，按核心数计，写入 cpu.max
+    uint64_t memory_bytes = 0;  // 内存上限，写入 memory.max
+    uint64_t pids = 0;          // 进程数上限，写入 pids.max
+};
+
+// 构建实际使用的资源
+struct ResourceUsage {
+    uint64_t memory_peak_bytes = 0;   // 内存峰值，内核不支持 memory.peak 时为0
+    double cpu_seconds = 0;           // 用户态和内核态CPU时间之和
+    uint64_t io_read_bytes = 0;
+    uint64_t io_write_bytes = 0;
+    uint64_t oom_kills = 0;           // 超出内存上限被终止的次数
+};
+
+// cgroup v2 管理器：每个构建在委托给服务器的 cgroup 下有独立的子 cgroup，写入资源上限，
+// 结束时读取用量并删除。超出内存上限时内核只终止该构建，不影响其他构建和服务器
+class CgroupManager {
+public:
+    // root 为委托给服务器的 cgroup 目录，为空时使用服务器进程所在的 cgroup，服务器进程移入其下的 server 子组；
+    // 不是 cgroup v2 或无权写入时抛出 std::runtime_error
+    explicit CgroupManager(const std::string& root);
+
+    // 禁止拷贝构造和赋值
+    CgroupManager(const CgroupManager&) = delete;
+    CgroupManager& operator=(const CgroupManager&) = delete;
+
+    // 为任务创建 cgroup 并写入上限，返回其 cgroup.procs 的描述符，子进程写入后加入该 cgroup；失败时抛出 std::runtime_error
+    int create(const std::string& job_id, const ResourceLimits& limits);
+
+    // 读取任务 cgroup 的用量
+    ResourceUsage usage(const std::string& job_id) const;
+
+    // 终止任务 cgroup 中残留的进程并删除 cgroup，返回删除前的用量
+    ResourceUsage remove(const std::string& job_id);
+
+    // 委托的 cgroup 目录
+    const std::string& root() const { return root_; }
+
+private:
+    // cpu.max 的周期(微秒)
+    static constexpr uint64_t kCpuPeriodMicros = 100000;
+
+    std::string root_;
+    std::vector<std::string> controllers_;   // 已在子 cgroup 中启用的控制器
+
+    // 任务的 cgroup 目录
+    std::string job_path(const std::string& job_id) const;
+
+    // 控制器是否可用
+    bool has_controller(const std::string& name) const;
+
+    // 删除 cgroup 目录：先终止其中的进程，再等待其退出
+    static void destroy(const std::string& path);
+};
+
+} // namespace lisa::server
+
+#endif // CGROUP_MANAGER_H
@@ -0,0 +1,152 @@
+#include "cluster_router.h"
+#include <chrono>
+#include <unordered_set>
+#include <git2.h>
+#include <httplib.h>
+
+using namespace lisa::server;
+
+ClusterRouter::ClusterRouter(const std::string& self, const std::vector<std::string>& peers, size_t virtual_nodes,
+                             time_t probe_interval_seconds)
+    : self_(self), probe_interval_seconds_(probe_interval_seconds), stop_(false) {
+    for (const auto& peer : peers) {
+        if (peer != self_) {
+            peers_.push_back(peer);
+        }
+    }
+    if (!enabled()) {
+        return;
+    }
+
+    // 每个节点在环上放置多个虚拟节点，节点加入或离开时只有相邻区间的仓库迁移
+    std::vector<std::string> members = peers_;
+    members.push_back(self_);
+    for (const auto& member : members) {
+        for (size_t i = 0; i < virtual_nodes; ++i) {
+            ring_[ring_hash(member + "#" + std::to_string(i))] = member;
+        }
+        states_[member] = NodeState{};
+    }
+
+    if (probe_interval_seconds_ > 0) {
+        probe_thread_ = std::thread(&ClusterRouter::probe_thread, this);
+    }
+}
+
+ClusterRouter::~ClusterRouter() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        stop_ = true;
+    }
+    stop_condition_.notify_all();
+
+    if (probe_thread_.joinable()) {
+        probe_thread_.join();
+    }
+}
+
+uint64_t ClusterRouter::ring_hash(const std::string& data) {
+    // 各节点必须得到相同的环，不能使用与实现相关的 std::hash
+    git_oid oid;
+    git_odb_hash(&oid, data.data(), data.size(), GIT_OBJECT_BLOB);
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(value); ++i) {
+        value = (value << 8) | oid.id[i];
+    }
+    return value;
+}
+
+std::vector<std::string> ClusterRouter::candidates(const std::string& repo_url) {
+    if (!enabled()) {
+        return {self_};
+    }
+
+    // 从仓库的位置顺时针遍历环，每个节点只取第一次出现
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> result;
+    std::unordered_set<std::string> seen;
+    auto start = ring_.lower_bound(ring_hash(repo_url));
+    for (size_t i = 0; i < ring_.size() && seen.size() < states_.size(); ++i, ++start) {
+        if (start == ring_.end()) {
+            start = ring_.begin();
+        }
+        const std::string& node = start->second;
+        if (!seen.insert(node).second) {
+            continue;
+        }
+        if (node == self_ || states_[node].healthy) {
+            result.push_back(node);
+        }
+    }
+    return result;
+}
+
+void ClusterRouter::mark_down(const std::string& node) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = states_.find(node);
+    if (it != states_.end() && it->second.healthy && node != self_) {
+        it->second.healthy = false;
+        Logger::warn("Cluster node " + node + " is unreachable, routing around it");
+    }
+}
+
+std::vector<ClusterNode> ClusterRouter::nodes() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<ClusterNode> result;
+    for (const auto& item : states_) {
+        result.push_back({item.first, item.second.healthy, item.first == self_, item.second.checked_at});
+    }
+    return result;
+}
+
+void ClusterRouter::remember_job(const std::string& job_id, const std::string& node) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (forwarded_jobs_.emplace(job_id, node).second) {
+        forwarded_order_.push_back(job_id);
+    }
+    while (forwarded_order_.size() > kMaxForwardedJobs) {
+        forwarded_jobs_.erase(forwarded_order_.front());
+        forwarded_order_.pop_front();
+    }
+}
+
+std::optional<std::string> ClusterRouter::job_node(const std::string& job_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = forwarded_jobs_.find(job_id);
+    if (it == forwarded_jobs_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void ClusterRouter::probe_thread() {
+    std::unique_lock<std::mutex> lock(stop_mutex_);
+    while (!stop_condition_.wait_for(lock, std::chrono::seconds(probe_interval_seconds_), [this] { return stop_; })) {
+        lock.unlock();
+        probe_all();
+        lock.lock();
+    }
+}
+
+void ClusterRouter::probe_all() {
+    for (const auto& peer : peers_) {
+        httplib::Client client("http://" + peer);
+        client.set_connection_timeout(kProbeTimeoutSeconds, 0);
+        client.set_read_timeout(kProbeTimeoutSeconds, 0);
+        auto response = client.Get("/health");
+        bool healthy = response && response->status == 200;
+        time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        NodeState& state = states_[peer];
+        if (state.healthy != healthy) {
+            if (healthy) {
+                Logger::info("Cluster node " + peer + " is up, taking back its repositories");
+            } else {
+                Logger::warn("Cluster node " + peer + " is down, routing around it");
+            }
+        }
+        state.healthy = healthy;
+        state.checked_at = now;
+    }
+}
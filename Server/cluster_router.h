@@ -0,0 +1,97 @@
+#ifndef CLUSTER_ROUTER_H
+#define CLUSTER_ROUTER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <optional>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ctime>
+#include "logger.h"
+
+namespace lisa::server {
+
+// 集群节点状态
+struct ClusterNode {
+    std::string address;   // host:port
+    bool healthy;
+    bool self;
+    time_t checked_at;     // 最近一次探测时间，本节点为0
+};
+
+// 集群路由器：按仓库地址在一致性哈希环上选择节点，使同一仓库的任务落在镜像、热构建目录和缓存所在的节点。
+// 后台线程探测其他节点的健康状态，不可用的节点被跳过，恢复后重新接管原来的仓库
+class ClusterRouter {
+public:
+    ClusterRouter(const std::string& self, const std::vector<std::string>& peers, size_t virtual_nodes,
+                  time_t probe_interval_seconds);
+    ~ClusterRouter();
+
+    // 禁止拷贝构造和赋值
+    ClusterRouter(const ClusterRouter&) = delete;
+    ClusterRouter& operator=(const ClusterRouter&) = delete;
+
+    // 是否启用路由：配置了本节点地址和其他节点
+    bool enabled() const { return !self_.empty() && !peers_.empty(); }
+
+    // 本节点地址
+    const std::string& self() const { return self_; }
+
+    // 按环上顺序返回仓库的候选节点，跳过不可用的节点；本节点始终在列表中
+    std::vector<std::string> candidates(const std::string& repo_url);
+
+    // 转发失败后把节点标记为不可用，等待下一次探测恢复
+    void mark_down(const std::string& node);
+
+    // 获取所有节点的状态
+    std::vector<ClusterNode> nodes();
+
+    // 记录转发到其他节点的任务
+    void remember_job(const std::string& job_id, const std::string& node);
+
+    // 查找转发任务所在的节点
+    std::optional<std::string> job_node(const std::string& job_id);
+
+private:
+    // 记录的转发任务数上限，超出时丢弃最早的记录
+    static constexpr size_t kMaxForwardedJobs = 65536;
+
+    // 健康探测的超时(秒)
+    static constexpr time_t kProbeTimeoutSeconds = 1;
+
+    // 节点的探测状态
+    struct NodeState {
+        bool healthy = true;
+        time_t checked_at = 0;
+    };
+
+    std::string self_;
+    std::vector<std::string> peers_;
+    time_t probe_interval_seconds_;
+    std::map<uint64_t, std::string> ring_;   // 虚拟节点哈希 -> 节点地址
+    std::unordered_map<std::string, NodeState> states_;
+    std::unordered_map<std::string, std::string> forwarded_jobs_;   // 任务ID -> 节点
+    std::deque<std::string> forwarded_order_;
+    std::mutex mutex_;
+    std::thread probe_thread_;
+    std::mutex stop_mutex_;
+    std::condition_variable stop_condition_;
+    bool stop_;
+
+    // 计算环上的位置
+    static uint64_t ring_hash(const std::string& data);
+
+    // 探测线程函数
+    void probe_thread();
+
+    // 探测一轮所有节点
+    void probe_all();
+};
+
+} // namespace lisa::server
+
+#endif // CLUSTER_ROUTER_H
@@ -9,25 +9,192 @@
 #include <future>
 #include <stdexcept>
 #include <algorithm>
+#include <csignal>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "process.h"
+#include "workspace.h"
+#include "metrics.h"
 
 namespace fs = std::filesystem;
 using json = nlohmann::json;
 using namespace lisa::server;
 
-CompilationHandler::CompilationHandler(const std::string& build_root_path, size_t max_concurrent_jobs)
-    : build_root_path_(build_root_path), max_concurrent_jobs_(max_concurrent_jobs), stop_workers_(false) {
+namespace {
+
+// 任务是否已结束
+bool is_finished(CompilationStatus status) {
+    return status == CompilationStatus::COMPLETED ||
+           status == CompilationStatus::FAILED ||
+           status == CompilationStatus::CANCELLED;
+}
+
+// 任务状态名称，用于API和任务日志
+const char* status_name(CompilationStatus status) {
+    switch (status) {
+        case CompilationStatus::FETCHING: return "fetching";
+        case CompilationStatus::PENDING: return "pending";
+        case CompilationStatus::RUNNING: return "running";
+        case CompilationStatus::PAUSED: return "paused";
+        case CompilationStatus::COMPLETED: return "completed";
+        case CompilationStatus::FAILED: return "failed";
+        case CompilationStatus::CANCELLED: return "cancelled";
+        default: return "unknown";
+    }
+}
+
+// 按结束状态取构建耗时直方图，句柄只注册一次
+const Histogram& build_duration(CompilationStatus status) {
+    static const auto make = [](CompilationStatus outcome) {
+        return Metrics::histogram("lisa_job_duration_seconds", "Build duration of jobs, by outcome",
+                                  {1, 5, 15, 30, 60, 120, 300, 600, 1200, 1800, 3600},
+                                  {{"outcome", status_name(outcome)}});
+    };
+    static const Histogram completed = make(CompilationStatus::COMPLETED);
+    static const Histogram failed = make(CompilationStatus::FAILED);
+    static const Histogram cancelled = make(CompilationStatus::CANCELLED);
+    switch (status) {
+        case CompilationStatus::COMPLETED: return completed;
+        case CompilationStatus::CANCELLED: return cancelled;
+        default: return failed;
+    }
+}
+
+// 解析任务状态名称，未知名称返回空
+std::optional<CompilationStatus> parse_status(const std::string& name) {
+    for (auto status : {CompilationStatus::FETCHING, CompilationStatus::PENDING, CompilationStatus::RUNNING,
+                        CompilationStatus::PAUSED, CompilationStatus::COMPLETED, CompilationStatus::FAILED,
+                        CompilationStatus::CANCELLED}) {
+        if (name == status_name(status)) {
+            return status;
+        }
+    }
+    return std::nullopt;
+}
+
+// 资源用量与任务日志中的JSON互相转换
+json usage_to_json(const ResourceUsage& usage) {
+    return {
+        {"memory_peak_bytes", usage.memory_peak_bytes},
+        {"cpu_seconds", usage.cpu_seconds},
+        {"io_read_bytes", usage.io_read_bytes},
+        {"io_write_bytes", usage.io_write_bytes},
+        {"oom_kills", usage.oom_kills}
+    };
+}
+
+ResourceUsage usage_from_json(const json& data) {
+    ResourceUsage usage;
+    usage.memory_peak_bytes = data.value("memory_peak_bytes", uint64_t{0});
+    usage.cpu_seconds = data.value("cpu_seconds", 0.0);
+    usage.io_read_bytes = data.value("io_read_bytes", uint64_t{0});
+    usage.io_write_bytes = data.value("io_write_bytes", uint64_t{0});
+    usage.oom_kills = data.value("oom_kills", uint64_t{0});
+    return usage;
+}
+
+// 进程资源用量和阶段记录与任务日志中的JSON互相转换
+json rusage_to_json(const ProcessUsage& usage) {
+    return {
+        {"user_cpu_seconds", usage.user_cpu_seconds},
+        {"system_cpu_seconds", usage.system_cpu_seconds},
+        {"max_rss_bytes", usage.max_rss_bytes},
+        {"voluntary_context_switches", usage.voluntary_context_switches},
+        {"involuntary_context_switches", usage.involuntary_context_switches}
+    };
+}
+
+ProcessUsage rusage_from_json(const json& data) {
+    ProcessUsage usage;
+    usage.user_cpu_seconds = data.value("user_cpu_seconds", 0.0);
+    usage.system_cpu_seconds = data.value("system_cpu_seconds", 0.0);
+    usage.max_rss_bytes = data.value("max_rss_bytes", uint64_t{0});
+    usage.voluntary_context_switches = data.value("voluntary_context_switches", uint64_t{0});
+    usage.involuntary_context_switches = data.value("involuntary_context_switches", uint64_t{0});
+    return usage;
+}
+
+json phases_to_json(const std::vector<PhaseSpan>& phases) {
+    json result = json::array();
+    for (const auto& phase : phases) {
+        result.push_back({{"name", phase.name}, {"start_us", phase.start_us}, {"end_us", phase.end_us}});
+    }
+    return result;
+}
+
+// 以分隔符连接字符串
+std::string join(const std::vector<std::string>& items, const std::string& separator) {
+    std::string joined;
+    for (const auto& item : items) {
+        if (!joined.empty()) joined += separator;
+        joined += item;
+    }
+    return joined;
+}
+
+} // namespace
+
+CompilationHandler::CompilationHandler(const std::string& build_root_path, size_t max_concurrent_jobs,
+                                       const CompilationOptions& options)
+    : build_root_path_(build_root_path),
+      max_concurrent_jobs_(max_concurrent_jobs),
+      options_(options),
+      job_queue_(options.tenant_weights),
+      queue_estimates_(std::make_shared<const QueueEstimates>()),
+      stop_workers_(false),
+      core_scheduler_(options.core_budget, max_concurrent_jobs) {
     // 创建构建根目录
     fs::create_directories(build_root_path_);
 
-    // 启动工作线程
-    for (size_t i = 0; i < max_concurrent_jobs_; ++i) {
+    if (options_.shortest_job_first) {
+        job_queue_.set_selector([this](const std::deque<QueuedJob>& jobs) { return select_shortest(jobs); });
+    }
+
+    // cgroup 不可用时构建照常运行，只是不受资源上限约束
+    if (options_.cgroups) {
+        try {
+            cgroups_ = std::make_unique<CgroupManager>(options_.cgroup_root);
+        } catch (const std::exception& e) {
+            Logger::error("Failed to set up cgroups, builds run without resource limits: " + std::string(e.what()));
+        }
+    }
+
+    // 先恢复上次运行的任务，再启动工作线程
+    if (!options_.journal_path.empty()) {
+        journal_ = std::make_unique<JobJournal>(options_.journal_path);
+        recover_jobs();
+    }
+
+    // 启动工作线程：被暂停的任务仍占用其工作线程，多出的一倍线程供抢占后的高优先级任务使用，
+    // 同时运行的任务数由 running_jobs_ 限制
+    for (size_t i = 0; i < 2 * max_concurrent_jobs_; ++i) {
         worker_threads_.emplace_back(&CompilationHandler::worker_thread, this);
     }
+    queue_publisher_thread_ = std::thread(&CompilationHandler::queue_publisher_thread, this);
 }
 
 CompilationHandler::~CompilationHandler() {
     stop_workers_ = true;
     job_condition_.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(publisher_mutex_);
+        publisher_condition_.notify_all();
+    }
+    if (queue_publisher_thread_.joinable()) {
+        queue_publisher_thread_.join();
+    }
+
+    // 终止仍在运行的构建，工作线程才能退出
+    auto jobs = jobs_.snapshot();
+    for (const auto& job : jobs) {
+        job->cancelled = true;
+        std::lock_guard<std::mutex> process_lock(job->process_mutex);
+        if (job->process_group > 0) {
+            kill(-job->process_group, SIGKILL);
+        }
+    }
 
     // 等待所有工作线程结束
     for (auto& thread : worker_threads_) {
@@ -37,8 +204,8 @@ CompilationHandler::~CompilationHandler() {
     }
 
     // 清理所有构建目录
-    for (const auto& entry : jobs_) {
-        fs::remove_all(create_build_directory(entry.first));
+    for (const auto& job : jobs) {
+        fs::remove_all(build_directory(job->id));
     }
 }
 
@@ -57,246 +224,1003 @@ std::string CompilationHandler::generate_job_id() {
     return ss.str();
 }
 
-std::string CompilationHandler::create_build_directory(const std::string& job_id) {
-    return build_root_path_ + "/" + job_id;
+ResourceLimits CompilationHandler::job_limits(const CompilationJob& job) const {
+    auto tenant = options_.tenant_limits.find(job.tenant);
+    ResourceLimits limits = tenant != options_.tenant_limits.end() ? tenant->second : options_.default_limits;
+    if (!job.config.contains("limits")) {
+        return limits;
+    }
+
+    const json& requested = job.config["limits"];
+    auto tighten = [](auto& limit, auto value) {
+        if (value > 0 && (limit == 0 || value < limit)) {
+            limit = value;
+        }
+    };
+    tighten(limits.cpus, requested.value("cpus", 0.0));
+    tighten(limits.memory_bytes, requested.value("memory_bytes", uint64_t{0}));
+    tighten(limits.pids, requested.value("pids", uint64_t{0}));
+    return limits;
 }
 
-std::string CompilationHandler::get_compile_command(const std::string& repo_path, const json& config) {
-    std::stringstream cmd;
+std::string CompilationHandler::prepare_build_directory(CompilationJob& job) {
+    if (!job.work_dir.empty()) {
+        return job.work_dir;
+    }
 
-    // 设置环境变量
-    if (config.contains("environment") && config["environment"].contains("variables")) {
-        for (const auto& var : config["environment"]["variables"]) {
-            cmd << var["name"] << "=\"" << var["value"] << "\" ";
-        }
+    std::string build_dir = build_directory(job.id);
+    if (fs::exists(build_dir)) {
+        // 获取流水线已提前填充
+        return build_dir;
     }
 
-    // 切换到仓库目录
-    cmd << "cd \"" << repo_path << "\" && ";
+    int64_t started = JobTrace::now();
+    PopulateMethod method = populate_workspace(job.repo_path, build_dir);
+    job.trace.record("checkout", started, JobTrace::now());
+    Logger::info("Populated build directory of job " + job.id + " by " + populate_method_name(method));
+    return build_dir;
+}
 
-    // 添加编译命令
+std::string CompilationHandler::get_compile_command(const json& config, size_t parallelism) {
     if (config.contains("build") && config["build"].contains("command")) {
-        cmd << config["build"]["command"];
-    } else {
-        // 默认编译命令
-        cmd << "make -j" << std::thread::hardware_concurrency();
+        return config["build"]["command"].get<std::string>();
     }
+    // 默认编译命令
+    return "make -j" + std::to_string(parallelism);
+}
 
-    // 重定向输出到日志文件
-    cmd << " > build.log 2>&1";
+std::vector<std::pair<std::string, std::string>> CompilationHandler::get_environment(const json& config) {
+    std::vector<std::pair<std::string, std::string>> variables;
+    if (!config.contains("environment") || !config["environment"].contains("variables")) {
+        return variables;
+    }
 
-    return cmd.str();
+    // 支持 [{"name": ..., "value": ...}] 和 {"NAME": "value"} 两种写法
+    const auto& vars = config["environment"]["variables"];
+    if (vars.is_object()) {
+        for (const auto& item : vars.items()) {
+            variables.emplace_back(item.key(), item.value().get<std::string>());
+        }
+    } else {
+        for (const auto& var : vars) {
+            variables.emplace_back(var["name"].get<std::string>(), var["value"].get<std::string>());
+        }
+    }
+    return variables;
 }
 
-int CompilationHandler::execute_compilation(CompilationJob& job) {
+int CompilationHandler::execute_compilation(CompilationJob& job, const std::vector<int>& cpus) {
+    // 先写退出码再发布结束状态
+    auto finish = [&job](CompilationStatus status, int exit_code) {
+        job.exit_code = exit_code;
+        job.status = status;
+        return exit_code;
+    };
+
     try {
-        // 创建构建目录
-        std::string build_dir = create_build_directory(job.id);
-        fs::create_directories(build_dir);
+        // 每个任务在独立的工作目录中构建，同一仓库的任务互不干扰
+        std::string build_dir = prepare_build_directory(job);
 
         // 获取编译命令
-        std::string compile_cmd = get_compile_command(job.repo_path, job.config);
+        std::string compile_cmd = get_compile_command(job.config, cpus.size());
         Logger::info("Executing compilation command for job " + job.id + ": " + compile_cmd);
 
+        // 标准输出和标准错误合并到同一管道，保持原有的交错顺序
+        int output_pipe[2];
+        if (pipe2(output_pipe, O_CLOEXEC) != 0) {
+            throw std::runtime_error("Failed to create output pipe");
+        }
+
+        ProcessSpec spec;
+        spec.argv = {"/bin/sh", "-c", compile_cmd};
+        spec.working_dir = build_dir;
+        spec.output_fd = output_pipe[1];
+        spec.cpus = cpus;
+
+        // 自定义命令中的 make、cmake --build 通过环境变量获得并行度，任务配置中的同名变量优先
+        // 分发编译单元时每个节点按本机分配的核心数计入并行度
+        auto environment = get_environment(job.config);
+        bool distributed = !options_.compiler_wrapper.empty() && !options_.remote_peers.empty();
+        std::string parallelism = std::to_string(cpus.size() * (distributed ? options_.remote_peers.size() + 1 : 1));
+        std::vector<std::pair<std::string, std::string>> defaults = {
+            {"MAKEFLAGS", "-j" + parallelism},
+            {"CMAKE_BUILD_PARALLEL_LEVEL", parallelism}
+        };
+
+        // 编译器调用经由包装程序查找编译器输出缓存：CMake 项目通过 launcher，其余通过 CC/CXX。
+        // 缓存键中的构建目录路径替换为相对路径，不同任务目录中的相同编译可以互相命中
+        if (!options_.compiler_wrapper.empty()) {
+            defaults.insert(defaults.end(), {
+                {"CMAKE_C_COMPILER_LAUNCHER", options_.compiler_wrapper},
+                {"CMAKE_CXX_COMPILER_LAUNCHER", options_.compiler_wrapper},
+                {"CC", options_.compiler_wrapper + " cc"},
+                {"CXX", options_.compiler_wrapper + " c++"}
+            });
+        }
+        if (!options_.compiler_wrapper.empty() && !options_.compiler_cache_path.empty()) {
+            defaults.insert(defaults.end(), {
+                {"LISA_CACHE_DIR", options_.compiler_cache_path},
+                {"LISA_CACHE_BASEDIR", fs::weakly_canonical(build_dir).string()}
+            });
+        }
+        if (distributed) {
+            defaults.insert(defaults.end(), {
+                {"LISA_REMOTE_PEERS", join(options_.remote_peers, ",")},
+                {"LISA_REMOTE_COMPILERS", join(options_.remote_compilers, ",")}
+            });
+        }
+
+        for (const auto& variable : defaults) {
+            bool overridden = std::any_of(environment.begin(), environment.end(),
+                                          [&](const auto& item) { return item.first == variable.first; });
+            if (!overridden) {
+                environment.push_back(variable);
+            }
+        }
+        spec.env = make_environment(environment);
+
         // 执行编译命令
         job.started_at = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-        job.status = CompilationStatus::RUNNING;
         job.progress = 10;
 
-        // 使用popen执行命令并捕获输出
-        FILE* pipe = popen(compile_cmd.c_str(), "r");
-        if (!pipe) {
-            throw std::runtime_error("Failed to execute compilation command");
+        // 每个构建在独立的 cgroup 中运行，超出内存上限时只有该构建被终止
+        int64_t spawned = JobTrace::now();
+        ChildProcess child;
+        try {
+            if (cgroups_) {
+                spec.cgroup_fd = cgroups_->create(job.id, job_limits(job));
+            }
+            child = ChildProcess::spawn(spec);
+        } catch (...) {
+            close(output_pipe[0]);
+            close(output_pipe[1]);
+            if (spec.cgroup_fd >= 0) {
+                close(spec.cgroup_fd);
+            }
+            throw;
+        }
+        close(output_pipe[1]);
+        if (spec.cgroup_fd >= 0) {
+            close(spec.cgroup_fd);
         }
 
-        // 定期检查取消标志
-        std::thread cancellation_checker([&]() {
-            while (job.status == CompilationStatus::RUNNING && !job.cancelled) {
-                std::this_thread::sleep_for(std::chrono::seconds(1));
+        // 发布进程组后再检查取消标志，与 cancel_job 的顺序相反，保证取消不会丢失
+        job.process_group = child.pid();
+        core_scheduler_.attach(job.id, child.pid());
+
+        // 异常退出时先在锁内清零进程组ID，之后 child 析构才终止并回收进程
+        struct ProcessGroupGuard {
+            CompilationJob& job;
+            ~ProcessGroupGuard() {
+                std::lock_guard<std::mutex> lock(job.process_mutex);
+                job.process_group = 0;
             }
-            if (job.cancelled) {
-                // 在实际实现中，这里应该获取进程ID并终止它
-                Logger::info("Compilation job " + job.id + " cancelled");
+        } process_group_guard{job};
+        if (job.cancelled) {
+            child.signal_group(SIGKILL);
+        }
+
+        // 边构建边读取输出，直到所有写端关闭；进度标记随输出增量解析
+        ProgressParser progress_parser;
+        char chunk[16384];
+        for (;;) {
+            ssize_t n = read(output_pipe[0], chunk, sizeof(chunk));
+            if (n > 0) {
+                job.output->append(chunk, static_cast<size_t>(n));
+                if (progress_parser.feed(chunk, static_cast<size_t>(n))) {
+                    update_progress(job, progress_parser.progress());
+                }
+            } else if (n == 0 || errno != EINTR) {
+                break;
             }
-        });
+        }
+        close(output_pipe[0]);
 
-        // 等待命令完成
-        int exit_code = pclose(pipe);
-        cancellation_checker.join();
+        // 等待命令完成：先等进程退出但不回收，再在锁内清零进程组ID并回收，
+        // 发信号的一方持同一把锁，读到的进程组ID在信号发出前不会被复用
+        child.wait_exit();
+        ProcessUsage rusage;
+        int exit_code = 0;
+        {
+            std::lock_guard<std::mutex> lock(job.process_mutex);
+            job.process_group = 0;
+            exit_code = child.wait(&rusage);
+        }
+        job.rusage = rusage;
+        job.trace.record("build", spawned, JobTrace::now());
+        if (cgroups_) {
+            job.usage = cgroups_->remove(job.id);
+            if (job.usage->oom_kills > 0) {
+                uint64_t memory_limit = job_limits(job).memory_bytes;
+                job.output->append(memory_limit > 0
+                    ? "Build killed: exceeded memory limit of " + std::to_string(memory_limit) + " bytes\n"
+                    : "Build killed: out of memory\n");
+            }
+        }
 
         job.progress = 100;
         job.completed_at = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-
-        // 读取输出日志
-        std::string log_path = job.repo_path + "/build.log";
-        std::ifstream log_file(log_path);
-        if (log_file.is_open()) {
-            job.output = std::string((std::istreambuf_iterator<char>(log_file)),
-                                     std::istreambuf_iterator<char>());
-            // 限制输出大小
-            if (job.output.size() > 1024 * 1024) { // 1MB
-                job.output = job.output.substr(0, 1024 * 1024) + "\n[Output truncated]";
-            }
-        }
+        job.output->close();
 
         // 设置最终状态
         if (job.cancelled) {
-            job.status = CompilationStatus::CANCELLED;
-            return -1;
+            Logger::info("Compilation job " + job.id + " cancelled");
+            return finish(CompilationStatus::CANCELLED, -1);
         } else if (WIFEXITED(exit_code) && WEXITSTATUS(exit_code) == 0) {
-            job.status = CompilationStatus::COMPLETED;
-            return 0;
+            return finish(CompilationStatus::COMPLETED, 0);
+        } else if (WIFSIGNALED(exit_code)) {
+            return finish(CompilationStatus::FAILED, 128 + WTERMSIG(exit_code));
         } else {
-            job.status = CompilationStatus::FAILED;
-            return WEXITSTATUS(exit_code);
+            return finish(CompilationStatus::FAILED, WEXITSTATUS(exit_code));
         }
     } catch (const std::exception& e) {
-        job.status = CompilationStatus::FAILED;
-        job.output = "Compilation error: " + std::string(e.what());
+        if (cgroups_) {
+            cgroups_->remove(job.id);
+        }
+        job.output->append("Compilation error: " + std::string(e.what()) + "\n");
+        job.output->close();
         job.completed_at = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-        return -1;
+        return finish(CompilationStatus::FAILED, -1);
     }
 }
 
 void CompilationHandler::worker_thread() {
     while (!stop_workers_) {
-        std::unique_lock<std::mutex> lock(jobs_mutex_);
-        job_condition_.wait(lock, [this] { return !job_queue_.empty() || stop_workers_; });
+        std::unique_lock<std::mutex> lock(schedule_mutex_);
+        job_condition_.wait(lock, [this] { return can_dispatch() || stop_workers_; });
 
         if (stop_workers_) break;
 
-        std::string job_id = job_queue_.front();
-        job_queue_.pop();
+        std::string job_id = *job_queue_.pop();
+        size_t pending = job_queue_.size();
+        queue_changed();
+
+        // 工作线程持有任务的引用，任务在构建期间被清理也不会失效
+        auto job_ptr = jobs_.find(job_id);
+        if (!job_ptr) {
+            Logger::error("Job not found: " + job_id);
+            continue;
+        }
+
+        CompilationJob& job = *job_ptr;
+        if (job.status != CompilationStatus::PENDING) {
+            // 排队期间已被取消
+            continue;
+        }
+
+        // 持锁转为运行中，之后的取消走终止进程组的路径
+        job.status = CompilationStatus::RUNNING;
+        ++running_jobs_;
+        job.trace.record("queue", job.queued_at_us, JobTrace::now());
 
         lock.unlock();
 
-        auto it = jobs_.find(job_id);
-        if (it == jobs_.end()) {
-            Logger::error("Job not found: " + job_id);
+        std::vector<int> cpus = core_scheduler_.acquire(job.id, pending);
+        auto build_started = std::chrono::steady_clock::now();
+        execute_compilation(job, cpus);
+        build_duration(job.status).observe(
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - build_started).count());
+
+        // 归还核心和名额、释放热目录、写入结果缓存
+        int64_t cleanup_started = JobTrace::now();
+        core_scheduler_.release(job.id, pending_jobs());
+        finish_job(job);
+        record_duration(job);
+        notify_completion(job);
+        job.trace.record("cleanup", cleanup_started, JobTrace::now());
+
+        // 停止服务时被终止的任务不记为结束，重启后重新构建
+        if (!stop_workers_) {
+            persist_finished(job);
+        }
+    }
+}
+
+bool CompilationHandler::can_dispatch() const {
+    return !job_queue_.empty() && running_jobs_ < max_concurrent_jobs_ &&
+           (paused_jobs_.empty() || job_queue_.has_priority(JobPriority::HIGH));
+}
+
+void CompilationHandler::preempt_for(const CompilationJob& urgent) {
+    JobTable::JobPtr victim;
+    for (const auto& job : jobs_.snapshot()) {
+        if (job->status != CompilationStatus::RUNNING || job->process_group <= 0 || job->priority <= urgent.priority) {
             continue;
         }
+        if (!victim || job->priority > victim->priority ||
+            (job->priority == victim->priority && job->started_at > victim->started_at)) {
+            victim = job;
+        }
+    }
+
+    // 工作线程写入结束状态时不持锁，只有仍在运行的任务才转为暂停
+    CompilationStatus running = CompilationStatus::RUNNING;
+    if (!victim || !victim->status.compare_exchange_strong(running, CompilationStatus::PAUSED)) {
+        return;
+    }
+
+    // 持有进程锁时工作线程不能回收构建进程，读到的进程组ID在信号发出前一直有效。
+    // 进程组ID为0说明进程已回收、尚未发布结束状态；kill(0, ...) 会暂停服务器自身所在的进程组
+    {
+        std::lock_guard<std::mutex> process_lock(victim->process_mutex);
+        pid_t process_group = victim->process_group;
+        if (process_group <= 0) {
+            // 工作线程可能已写入结束状态，只撤销本次的暂停
+            CompilationStatus paused = CompilationStatus::PAUSED;
+            victim->status.compare_exchange_strong(paused, CompilationStatus::RUNNING);
+            return;
+        }
+
+        // 暂停后进程保留全部内存状态，恢复后从断点继续，已完成的编译不会丢失
+        victim->paused_at = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        kill(-process_group, SIGSTOP);
+    }
+    paused_jobs_.push_back(victim->id);
+    --running_jobs_;
+    core_scheduler_.release(victim->id, job_queue_.size());
+    Logger::info("Paused job " + victim->id + " for high-priority job " + urgent.id);
+}
+
+void CompilationHandler::resume_paused() {
+    while (!paused_jobs_.empty() && running_jobs_ < max_concurrent_jobs_ &&
+           !job_queue_.has_priority(JobPriority::HIGH)) {
+        std::string job_id = paused_jobs_.front();
+        paused_jobs_.pop_front();
+
+        auto job_ptr = jobs_.find(job_id);
+        CompilationStatus paused = CompilationStatus::PAUSED;
+        if (!job_ptr || !job_ptr->status.compare_exchange_strong(paused, CompilationStatus::RUNNING)) {
+            continue;
+        }
+
+        // 重新分配核心并绑定后再继续运行；进程已被回收时只恢复名额，
+        // 进程组为0时绑定和信号都会作用到服务器自身
+        CompilationJob& job = *job_ptr;
+        core_scheduler_.acquire(job.id, job_queue_.size());
+        {
+            std::lock_guard<std::mutex> process_lock(job.process_mutex);
+            pid_t process_group = job.process_group;
+            if (process_group > 0) {
+                core_scheduler_.attach(job.id, process_group);
+                kill(-process_group, SIGCONT);
+            }
+        }
+
+        time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        job.paused_seconds += now - job.paused_at;
+        job.paused_at = 0;
+        ++running_jobs_;
+        Logger::info("Resumed job " + job.id);
+    }
+}
+
+void CompilationHandler::finish_job(const CompilationJob& job) {
+    {
+        std::lock_guard<std::mutex> lock(schedule_mutex_);
+
+        // 暂停期间结束（例如被取消）的任务已经归还过名额
+        auto paused = std::find(paused_jobs_.begin(), paused_jobs_.end(), job.id);
+        if (paused != paused_jobs_.end()) {
+            paused_jobs_.erase(paused);
+        } else {
+            --running_jobs_;
+        }
+        resume_paused();
+    }
+    job_condition_.notify_all();
+}
+
+void CompilationHandler::record_duration(const CompilationJob& job) {
+    // 被取消的构建耗时不代表真实构建时间
+    if (job.status != CompilationStatus::COMPLETED && job.status != CompilationStatus::FAILED) {
+        return;
+    }
+    double seconds = static_cast<double>(job.completed_at - job.started_at - job.paused_seconds);
+    duration_estimator_.record(job.duration_key, seconds);
+}
+
+void CompilationHandler::update_progress(CompilationJob& job, const BuildProgress& progress) {
+    job.units_completed = progress.units_completed;
+    job.units_total = progress.units_total;
+    if (progress.percent < 0) {
+        return;
+    }
+
+    // 多轮构建（如先构建依赖）时百分比会回落，任务进度只前进；100 留给构建结束
+    int percent = std::min(progress.percent, 99);
+    int current = job.progress;
+    while (percent > current && !job.progress.compare_exchange_weak(current, percent)) {
+    }
+    job.progress_reported = true;
+}
+
+std::optional<double> CompilationHandler::remaining_seconds(const CompilationJob& job, time_t now) {
+    double elapsed = static_cast<double>(now - job.started_at - job.paused_seconds);
+    double expected = duration_estimator_.expected_seconds(job.duration_key);
+    std::optional<double> by_history;
+    if (expected > 0) {
+        by_history = std::max(0.0, expected - elapsed);
+    }
+
+    int percent = job.progress;
+    if (!job.progress_reported || percent <= 0) {
+        return by_history;
+    }
+    double extrapolated = elapsed * (100 - percent) / percent;
+    if (!by_history) {
+        return extrapolated;
+    }
+    return (percent * extrapolated + (100 - percent) * *by_history) / 100;
+}
+
+size_t CompilationHandler::select_shortest(const std::deque<QueuedJob>& jobs) const {
+    time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+
+    size_t best = 0;
+    std::optional<double> best_score;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        double waited = static_cast<double>(now - jobs[i].queued_at);
+        double score = jobs[i].expected_seconds - options_.aging_factor * waited;
+        if (!best_score || score < *best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+std::optional<time_t> CompilationHandler::estimate_wait(const std::string& job_id, std::optional<size_t>& position) {
+    auto estimates = std::atomic_load(&queue_estimates_);
+    auto it = estimates->find(job_id);
+    if (it == estimates->end()) {
+        return std::nullopt;
+    }
+    position = it->second.position;
+    return it->second.wait_seconds;
+}
+
+void CompilationHandler::queue_changed() {
+    queued_jobs_ = job_queue_.size();
+    {
+        // 在发布线程的锁内置位，不会在它检查条件和开始等待之间丢失通知
+        std::lock_guard<std::mutex> lock(publisher_mutex_);
+        queue_order_stale_ = true;
+    }
+    publisher_condition_.notify_one();
+}
+
+void CompilationHandler::queue_publisher_thread() {
+    std::unique_lock<std::mutex> lock(publisher_mutex_);
+    while (!stop_workers_) {
+        // 队列没有变化时也定期重算，否则排队位置和等待时间停留在上次变化时的值
+        bool changed = publisher_condition_.wait_for(lock, kQueueEstimateMaxAge,
+                                                     [this] { return queue_order_stale_ || stop_workers_; });
+        if (stop_workers_) break;
+        if (!changed && queued_jobs_ == 0) continue;
+
+        lock.unlock();
+        publish_queue_estimates();
+        lock.lock();
+
+        // 限制重算频率，期间的队列变化合并到下一次
+        publisher_condition_.wait_for(lock, kQueueEstimateMinInterval, [this] { return stop_workers_.load(); });
+    }
+}
+
+void CompilationHandler::publish_queue_estimates() {
+    // 只在复制队列时持锁；模拟出队的代价随队列长度平方增长，在副本上进行，不阻塞调度
+    FairShareQueue queue;
+    {
+        std::lock_guard<std::mutex> lock(schedule_mutex_);
+        queue = job_queue_;
+        queue_order_stale_ = false;
+    }
+    std::vector<QueuedJob> order = queue.order();
+
+    // 前面所有任务和运行中任务的剩余耗时由全部工作线程分摊
+    time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    double busy_seconds = 0;
+    for (const auto& job : jobs_.snapshot()) {
+        if (job->status == CompilationStatus::RUNNING) {
+            busy_seconds += remaining_seconds(*job, now).value_or(0);
+        }
+    }
 
-        CompilationJob& job = *it->second;
-        job.exit_code = execute_compilation(job);
+    auto estimates = std::make_shared<QueueEstimates>();
+    estimates->reserve(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        (*estimates)[order[i].id] = {i, static_cast<time_t>(busy_seconds / max_concurrent_jobs_)};
+        busy_seconds += order[i].expected_seconds;
+    }
+    std::atomic_store(&queue_estimates_, std::shared_ptr<const QueueEstimates>(std::move(estimates)));
+}
+
+size_t CompilationHandler::queued_job_count() {
+    return queued_jobs_;
+}
+
+size_t CompilationHandler::running_job_count() const {
+    return running_jobs_;
+}
+
+size_t CompilationHandler::pending_jobs() {
+    std::lock_guard<std::mutex> lock(schedule_mutex_);
+    return job_queue_.size();
+}
+
+void CompilationHandler::notify_completion(const CompilationJob& job) {
+    std::lock_guard<std::mutex> lock(listeners_mutex_);
+    for (const auto& listener : completion_listeners_) {
+        try {
+            listener(job);
+        } catch (const std::exception& e) {
+            Logger::error("Completion listener failed for job " + job.id + ": " + e.what());
+        }
     }
 }
 
 std::string CompilationHandler::create_job(const std::string& repo_path, const json& config) {
-    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    std::string job_id = create_fetching_job(config);
+    start_job(job_id, repo_path);
+    return job_id;
+}
 
+std::string CompilationHandler::create_fetching_job(const json& config) {
     std::string job_id = generate_job_id();
-    auto job = std::make_unique<CompilationJob>();
+
+    // 创建记录先于任务加入任务表写入，保证先于该任务的任何结束记录
+    if (journal_) {
+        journal_->append(job_id, {{"config", config}, {"status", status_name(CompilationStatus::FETCHING)}});
+    }
+
+    jobs_.insert(job_id, make_job(job_id, config));
+    Logger::info("Created new compilation job: " + job_id);
+
+    return job_id;
+}
+
+std::shared_ptr<CompilationJob> CompilationHandler::make_job(const std::string& job_id, const json& config) const {
+    auto job = std::make_shared<CompilationJob>();
 
     job->id = job_id;
-    job->repo_path = repo_path;
     job->config = config;
+    job->tenant = config.value("tenant", config.value("repo_url", ""));
+    job->priority = parse_priority(config.value("priority", "normal"));
+    std::string command = config.contains("build") ? config["build"].value("command", "") : "";
+    job->duration_key = DurationEstimator::make_key(config.value("repo_url", ""), command);
+    job->output = std::make_shared<OutputBuffer>(options_.output_head_bytes, options_.output_tail_bytes);
+    return job;
+}
+
+void CompilationHandler::recover_jobs() {
+    std::error_code ec;
+    for (const auto& entry : journal_->recover()) {
+        const json& fields = entry.second;
+        auto job = make_job(entry.first, fields.value("config", json::object()));
+
+        auto status = parse_status(fields.value("status", ""));
+        if (status && is_finished(*status)) {
+            job->status = *status;
+            job->exit_code = fields.value("exit_code", -1);
+            job->progress = 100;
+            job->started_at = fields.value("started_at", time_t{0});
+            job->completed_at = fields.value("completed_at", time_t{0});
+            job->paused_seconds = fields.value("paused_seconds", time_t{0});
+            job->cached = fields.value("cached", false);
+            if (fields.contains("usage")) {
+                job->usage = usage_from_json(fields["usage"]);
+            }
+            if (fields.contains("rusage")) {
+                job->rusage = rusage_from_json(fields["rusage"]);
+            }
+            for (const auto& phase : fields.value("phases", json::array())) {
+                job->trace.record(phase.value("name", ""), phase.value("start_us", int64_t{0}),
+                                  phase.value("end_us", int64_t{0}));
+            }
+            job->output.reset();
+            job->output_spilled = true;
+        } else {
+            // 检出目录在重启时已清理，未结束的任务从获取阶段重新开始；只删除该任务自己的构建目录
+            fs::remove_all(build_directory(entry.first), ec);
+            recovered_jobs_.push_back(entry.first);
+        }
+        jobs_.insert(entry.first, std::move(job));
+    }
+
+    // 任务ID以创建时间开头，按ID排序即按提交先后重新排队
+    std::sort(recovered_jobs_.begin(), recovered_jobs_.end());
+    if (!recovered_jobs_.empty()) {
+        Logger::info("Requeueing " + std::to_string(recovered_jobs_.size()) + " unfinished jobs from journal");
+    }
+}
+
+std::vector<std::string> CompilationHandler::take_recovered_jobs() {
+    std::lock_guard<std::mutex> lock(schedule_mutex_);
+    return std::move(recovered_jobs_);
+}
+
+void CompilationHandler::persist_finished(CompilationJob& job) {
+    if (!journal_) {
+        return;
+    }
+
+    // 先写输出再写结束记录，恢复出的已结束任务总能读到输出
+    try {
+        json fields = {
+            {"status", status_name(job.status)},
+            {"exit_code", job.exit_code.load()},
+            {"started_at", job.started_at.load()},
+            {"completed_at", job.completed_at.load()},
+            {"paused_seconds", job.paused_seconds.load()},
+            {"cached", job.cached.load()}
+        };
+        if (job.usage) {
+            fields["usage"] = usage_to_json(*job.usage);
+        }
+        if (job.rusage) {
+            fields["rusage"] = rusage_to_json(*job.rusage);
+        }
+        int64_t started = JobTrace::now();
+        journal_->write_output(job.id, std::atomic_load(&job.output)->snapshot());
+        journal_->append(job.id, fields);
+
+        // 输出落盘也是一个阶段，记录后再写入全部阶段
+        job.trace.record("logs", started, JobTrace::now());
+        journal_->append(job.id, {{"phases", phases_to_json(job.trace.spans())}});
+    } catch (const std::exception& e) {
+        Logger::error("Failed to persist job " + job.id + ": " + e.what());
+        return;
+    }
+
+    // 先标记已落盘再释放缓冲，读取方取不到缓冲时改从磁盘读取；正在流式读取的一方仍持有原缓冲
+    job.output_spilled = true;
+    std::atomic_store(&job.output, std::shared_ptr<OutputBuffer>());
+}
+
+bool CompilationHandler::start_job(const std::string& job_id, const std::string& repo_path, const std::string& cache_key,
+                                   const std::string& work_dir) {
+    std::lock_guard<std::mutex> lock(schedule_mutex_);
+
+    auto job = jobs_.find(job_id);
+    if (!job || job->status != CompilationStatus::FETCHING) {
+        return false;
+    }
+
+    job->repo_path = repo_path;
+    job->cache_key = cache_key;
+    job->work_dir = work_dir;
+    job->queued_at = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    job->queued_at_us = JobTrace::now();
     job->status = CompilationStatus::PENDING;
-    job->progress = 0;
-    job->exit_code = -1;
-    job->cancelled = false;
-    job->started_at = 0;
-    job->completed_at = 0;
+    // 预计耗时在入队时取一次，出队选择时不再查询耗时历史
+    job_queue_.push({job_id, duration_estimator_.expected_seconds(job->duration_key), job->queued_at},
+                    job->tenant, job->priority);
+    queue_changed();
 
-    jobs_[job_id] = std::move(job);
-    job_queue_.push(job_id);
+    // 高优先级任务立即获得名额，不等待低优先级构建结束
+    if (job->priority == JobPriority::HIGH && running_jobs_ >= max_concurrent_jobs_) {
+        preempt_for(*job);
+    }
 
-    job_condition_.notify_one();
-    Logger::info("Created new compilation job: " + job_id);
+    job_condition_.notify_all();
+    Logger::info("Queued compilation job: " + job_id);
 
-    return job_id;
+    return true;
 }
 
-std::optional<JobStatusInfo> CompilationHandler::get_job_status(const std::string& job_id) {
-    std::lock_guard<std::mutex> lock(jobs_mutex_);
+bool CompilationHandler::complete_cached_job(const std::string& job_id, int exit_code, const std::string& output) {
+    std::unique_lock<std::mutex> lock(schedule_mutex_);
+
+    auto job = jobs_.find(job_id);
+    if (!job || job->status != CompilationStatus::FETCHING) {
+        return false;
+    }
+
+    time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    job->cached = true;
+    job->exit_code = exit_code;
+    job->progress = 100;
+    job->started_at = now;
+    job->completed_at = now;
+    job->output->append(output);
+    job->output->close();
+    job->status = exit_code == 0 ? CompilationStatus::COMPLETED : CompilationStatus::FAILED;
+    Logger::info("Compilation job " + job_id + " served from result cache");
+
+    lock.unlock();
+    persist_finished(*job);
+    return true;
+}
 
-    auto it = jobs_.find(job_id);
-    if (it == jobs_.end()) {
+void CompilationHandler::add_completion_listener(CompletionListener listener) {
+    std::lock_guard<std::mutex> lock(listeners_mutex_);
+    completion_listeners_.push_back(std::move(listener));
+}
+
+void CompilationHandler::clear_completion_listeners() {
+    std::lock_guard<std::mutex> lock(listeners_mutex_);
+    completion_listeners_.clear();
+}
+
+void CompilationHandler::fail_job(const std::string& job_id, const std::string& message) {
+    std::unique_lock<std::mutex> lock(schedule_mutex_);
+
+    auto job = jobs_.find(job_id);
+    if (!job || job->status != CompilationStatus::FETCHING) {
+        return;
+    }
+
+    job->output->append(message + "\n");
+    job->output->close();
+    job->completed_at = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    job->status = CompilationStatus::FAILED;
+    Logger::error("Compilation job " + job_id + " failed before build: " + message);
+
+    lock.unlock();
+    persist_finished(*job);
+}
+
+bool CompilationHandler::has_job(const std::string& job_id) {
+    return jobs_.find(job_id) != nullptr;
+}
+
+std::optional<JobStatusInfo> CompilationHandler::get_job_status(const std::string& job_id) {
+    auto job = jobs_.find(job_id);
+    if (!job) {
         return std::nullopt;
     }
 
-    const auto& job = it->second;
+    // 先读状态，结束状态发布前其余字段已写好
+    CompilationStatus status = job->status;
     JobStatusInfo status_info;
 
     status_info.job_id = job->id;
     status_info.progress = job->progress;
+    if (job->units_completed > 0) {
+        status_info.units_completed = job->units_completed;
+    }
+    if (job->units_total > 0) {
+        status_info.units_total = job->units_total;
+    }
     status_info.started_at = job->started_at;
     status_info.completed_at = job->completed_at;
-    status_info.completed = job->status == CompilationStatus::COMPLETED || 
-                           job->status == CompilationStatus::FAILED || 
-                           job->status == CompilationStatus::CANCELLED;
+    status_info.paused_seconds = job->paused_seconds;
+    if (status == CompilationStatus::PAUSED) {
+        status_info.paused_seconds += std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()) - job->paused_at;
+    }
+    status_info.cached = job->cached;
 
-    switch (job->status) {
-        case CompilationStatus::PENDING: status_info.status = "pending"; break;
-        case CompilationStatus::RUNNING: status_info.status = "running"; break;
-        case CompilationStatus::COMPLETED: status_info.status = "completed"; break;
-        case CompilationStatus::FAILED: status_info.status = "failed"; break;
-        case CompilationStatus::CANCELLED: status_info.status = "cancelled"; break;
-        default: status_info.status = "unknown"; break;
+    // 按历史耗时估算完成时间，尚无任何历史时不返回
+    time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    double expected = duration_estimator_.expected_seconds(job->duration_key);
+    if (expected > 0) {
+        status_info.estimated_duration_seconds = static_cast<time_t>(expected);
     }
+    std::optional<DurationEstimate> estimate;
+    if (!is_finished(status)) {
+        estimate = duration_estimator_.estimate(job->duration_key);
+        if (estimate) {
+            status_info.estimated_duration_p90_seconds = static_cast<time_t>(estimate->p90_seconds);
+        }
+    }
+    if (status == CompilationStatus::PENDING) {
+        status_info.estimated_wait_seconds = estimate_wait(job_id, status_info.queue_position);
+        if (status_info.estimated_wait_seconds && expected > 0) {
+            status_info.eta = now + *status_info.estimated_wait_seconds + static_cast<time_t>(expected);
+        }
+        if (status_info.estimated_wait_seconds && estimate) {
+            status_info.eta_p90 = now + *status_info.estimated_wait_seconds + static_cast<time_t>(estimate->p90_seconds);
+        }
+    } else if (status == CompilationStatus::RUNNING) {
+        if (auto remaining = remaining_seconds(*job, now)) {
+            status_info.eta = now + static_cast<time_t>(*remaining);
+        }
+        if (estimate) {
+            double elapsed = static_cast<double>(now - job->started_at - job->paused_seconds);
+            status_info.eta_p90 = now + static_cast<time_t>(std::max(0.0, estimate->p90_seconds - elapsed));
+        }
+    }
+    status_info.completed = is_finished(status);
+
+    status_info.status = status_name(status);
 
     return status_info;
 }
 
 std::optional<JobResultInfo> CompilationHandler::get_job_result(const std::string& job_id) {
-    std::lock_guard<std::mutex> lock(jobs_mutex_);
-
-    auto it = jobs_.find(job_id);
-    if (it == jobs_.end()) {
+    auto job = jobs_.find(job_id);
+    if (!job) {
         return std::nullopt;
     }
 
-    const auto& job = it->second;
+    CompilationStatus status = job->status;
     JobResultInfo result_info;
 
     result_info.job_id = job->id;
     result_info.exit_code = job->exit_code;
-    result_info.output = job->output;
     result_info.completed_at = job->completed_at;
-    result_info.completed = job->status == CompilationStatus::COMPLETED || 
-                           job->status == CompilationStatus::FAILED || 
-                           job->status == CompilationStatus::CANCELLED;
+    result_info.cached = job->cached;
+    result_info.completed = is_finished(status);
+    if (result_info.completed) {
+        result_info.usage = job->usage;
+        result_info.rusage = job->rusage;
+    }
+    result_info.phases = job->trace.spans();
 
-    switch (job->status) {
+    switch (status) {
         case CompilationStatus::COMPLETED: result_info.status = "completed"; break;
         case CompilationStatus::FAILED: result_info.status = "failed"; break;
         case CompilationStatus::CANCELLED: result_info.status = "cancelled"; break;
         default: result_info.status = "in_progress"; break;
     }
 
+    // 缓冲已释放时输出已落盘
+    auto output = std::atomic_load(&job->output);
+    if (output) {
+        result_info.output = output->snapshot();
+    } else if (job->output_spilled) {
+        result_info.output = journal_->read_output(job_id).value_or("");
+    }
     return result_info;
 }
 
-bool CompilationHandler::cancel_job(const std::string& job_id) {
-    std::lock_guard<std::mutex> lock(jobs_mutex_);
+void CompilationHandler::record_phase(const std::string& job_id, const std::string& name, int64_t start_us,
+                                      int64_t end_us) {
+    if (auto job = jobs_.find(job_id)) {
+        job->trace.record(name, start_us, end_us);
+    }
+}
 
-    auto it = jobs_.find(job_id);
-    if (it == jobs_.end()) {
-        return false;
+std::vector<JobTraceInfo> CompilationHandler::get_job_traces(int64_t from_us, int64_t to_us) {
+    std::vector<JobTraceInfo> traces;
+    for (const auto& job : jobs_.snapshot()) {
+        auto phases = job->trace.spans();
+        bool overlaps = std::any_of(phases.begin(), phases.end(), [&](const PhaseSpan& phase) {
+            return phase.start_us <= to_us && phase.end_us >= from_us;
+        });
+        if (overlaps) {
+            traces.push_back({job->id, std::move(phases)});
+        }
     }
 
-    auto& job = it->second;
-    if (job->status == CompilationStatus::COMPLETED || 
-        job->status == CompilationStatus::FAILED || 
-        job->status == CompilationStatus::CANCELLED) {
+    auto first_start = [](const JobTraceInfo& trace) {
+        int64_t start = trace.phases.front().start_us;
+        for (const auto& phase : trace.phases) {
+            start = std::min(start, phase.start_us);
+        }
+        return start;
+    };
+    std::sort(traces.begin(), traces.end(), [&](const JobTraceInfo& a, const JobTraceInfo& b) {
+        return first_start(a) < first_start(b);
+    });
+    return traces;
+}
+
+std::optional<json> CompilationHandler::get_job_config(const std::string& job_id) {
+    auto job = jobs_.find(job_id);
+    if (!job) {
+        return std::nullopt;
+    }
+    return job->config;
+}
+
+std::shared_ptr<OutputBuffer> CompilationHandler::get_job_output(const std::string& job_id) {
+    auto job = jobs_.find(job_id);
+    if (!job) {
+        return nullptr;
+    }
+    if (auto output = std::atomic_load(&job->output)) {
+        return output;
+    }
+
+    // 已结束任务的输出从磁盘读出，包装成已关闭的缓冲
+    std::string output = journal_->read_output(job_id).value_or("");
+    auto buffer = std::make_shared<OutputBuffer>(output.size(), 0);
+    buffer->append(output);
+    buffer->close();
+    return buffer;
+}
+
+bool CompilationHandler::cancel_job(const std::string& job_id) {
+    auto job = jobs_.find(job_id);
+    if (!job || is_finished(job->status)) {
         return false;
     }
 
     job->cancelled = true;
-    return true;
+
+    // 尚未开始编译的任务直接结束，工作线程和获取流水线会跳过它；与出队、入队的状态转换在同一把锁下进行
+    std::unique_lock<std::mutex> lock(schedule_mutex_);
+    CompilationStatus status = job->status;
+    if (status == CompilationStatus::FETCHING || status == CompilationStatus::PENDING) {
+        job->completed_at = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        job->output->close();
+        job->status = CompilationStatus::CANCELLED;
+
+        // 排队中的任务已持有工作目录等资源，由回调释放；获取阶段的任务由获取流水线处理
+        if (status == CompilationStatus::PENDING) {
+            job_queue_.remove(job_id);
+            queue_changed();
+            resume_paused();
+            lock.unlock();
+            job_condition_.notify_all();
+            notify_completion(*job);
+        } else {
+            lock.unlock();
+        }
+        persist_finished(*job);
+        return true;
+    }
+    lock.unlock();
+
+    // 正在编译或已暂停的任务立即终止整个构建进程组，SIGKILL 对已停止的进程同样有效。
+    // 持有进程锁时构建进程不会被回收，进程组ID不会被复用
+    std::unique_lock<std::mutex> process_lock(job->process_mutex);
+    pid_t process_group = job->process_group;
+    if (process_group > 0) {
+        kill(-process_group, SIGKILL);
+        process_lock.unlock();
+        Logger::info("Killed process group " + std::to_string(process_group) + " of job " + job_id);
+    }
+    return !is_finished(status);
 }
 
 void CompilationHandler::clean_expired_jobs(time_t max_age_seconds) {
-    std::lock_guard<std::mutex> lock(jobs_mutex_);
     time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
 
-    for (auto it = jobs_.begin(); it != jobs_.end();) {
-        const auto& job = it->second;
-        if (job->completed_at > 0 && now - job->completed_at > max_age_seconds) {
+    // 先从任务表中摘除，再在锁外删除目录；仍在读取的一方持有的任务记录不受影响
+    std::vector<std::string> expired;
+    for (const auto& job : jobs_.snapshot()) {
+        time_t completed_at = job->completed_at;
+        if (is_finished(job->status) && completed_at > 0 && now - completed_at > max_age_seconds) {
             Logger::info("Cleaning expired job: " + job->id);
-            fs::remove_all(create_build_directory(job->id));
-            it = jobs_.erase(it);
-        } else {
-            ++it;
+            jobs_.erase(job->id);
+            expired.push_back(job->id);
+        }
+    }
+
+    for (const auto& job_id : expired) {
+        fs::remove_all(build_directory(job_id));
+        if (journal_) {
+            journal_->remove(job_id);
+        }
+    }
+    if (journal_) {
+        journal_->compact_if_needed();
+    }
+}
+
+std::unordered_set<std::string> CompilationHandler::active_repo_paths() {
+    // 代码目录在入队时持锁写入
+    std::lock_guard<std::mutex> lock(schedule_mutex_);
+
+    std::unordered_set<std::string> paths;
+    for (const auto& job : jobs_.snapshot()) {
+        if (!is_finished(job->status) && !job->repo_path.empty()) {
+            paths.insert(job->repo_path);
         }
     }
-}
\ No newline at end of file
+    return paths;
+}
+
+std::vector<CacheEntry> CompilationHandler::cache_entries() {
+    time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+
+    std::vector<CacheEntry> entries;
+    for (const auto& job : jobs_.snapshot()) {
+        bool finished = is_finished(job->status);
+        entries.push_back({build_directory(job->id), finished ? job->completed_at.load() : now, !finished});
+    }
+    return entries;
+}
+
+bool CompilationHandler::evict(const std::string& path) {
+    auto job = jobs_.find(fs::path(path).filename().string());
+    if (!job || !is_finished(job->status)) {
+        return false;
+    }
+
+    // 任务记录保留到过期，只释放磁盘空间
+    fs::remove_all(path);
+    return true;
+}
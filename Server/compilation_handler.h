@@ -8,34 +8,92 @@
 #include <future>
 #include <chrono>
 #include <condition_variable>
-#include <queue>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <unordered_set>
+#include <functional>
 #include <nlohmann/json.hpp>
+#include <sys/types.h>
+#include "cache_entry.h"
+#include "output_buffer.h"
+#include "core_scheduler.h"
+#include "job_queue.h"
+#include "duration_estimator.h"
+#include "job_journal.h"
+#include "job_table.h"
+#include "progress_parser.h"
+#include "cgroup_manager.h"
+#include "job_trace.h"
+#include "process.h"
 #include "logger.h"
 
 namespace lisa::server {
 
 // 编译任务状态
 enum class CompilationStatus {
+    FETCHING,
     PENDING,
     RUNNING,
+    PAUSED,      // 被高优先级任务抢占，进程组已暂停
     COMPLETED,
     FAILED,
     CANCELLED
 };
 
-// 编译任务信息
+// 编译处理器选项
+struct CompilationOptions {
+    size_t output_head_bytes = 256 * 1024;   // 保留的构建输出开头字节数
+    size_t output_tail_bytes = 768 * 1024;   // 保留的构建输出结尾字节数
+    size_t core_budget = 0;                  // 构建可用的CPU核心数，0 表示全部
+    std::unordered_map<std::string, double> tenant_weights;   // 租户调度权重，未列出的为 1
+    bool shortest_job_first = false;   // 租户子队列内按预计耗时最短优先出队
+    double aging_factor = 1.0;         // 每排队一秒，预计耗时按该系数折减，防止长任务饿死
+    std::string compiler_wrapper;      // 编译器包装程序路径，为空表示不经过包装程序
+    std::string compiler_cache_path;   // 编译器输出缓存路径，为空表示不使用编译器输出缓存
+    std::vector<std::string> remote_peers;       // 分发编译单元的节点（host:port）
+    std::vector<std::string> remote_compilers;   // 可以分发的编译器名称
+    std::string journal_path;          // 任务日志目录，为空时任务只保存在内存中
+    bool cgroups = false;              // 每个构建在独立的 cgroup 中运行并受资源上限约束
+    std::string cgroup_root;           // 委托给服务器的 cgroup 目录，为空时使用服务器进程所在的 cgroup
+    ResourceLimits default_limits;     // 构建的默认资源上限
+    std::unordered_map<std::string, ResourceLimits> tenant_limits;   // 租户的资源上限，代替默认上限
+};
+
+// 编译任务信息。状态、进度和时间戳是原子字段，查询方不加锁读取；写入方先写结果字段再发布状态，
+// 读到结束状态时退出码、输出和完成时间已就绪。其余字段在任务入队前写好，之后只读
 struct CompilationJob {
     std::string id;
-    std::string repo_path;
+    std::string repo_path;   // 代码目录，只作为工作目录的模板，不在其中构建
     nlohmann::json config;
-    CompilationStatus status;
-    int progress;
-    int exit_code;
-    std::string output;
-    time_t started_at;
-    time_t completed_at;
+    std::string tenant;      // 调度租户，未指定时为仓库地址
+    JobPriority priority = JobPriority::NORMAL;
+    std::string duration_key;   // 耗时历史的键
+    time_t queued_at = 0;       // 进入编译队列的时间
+    int64_t queued_at_us = 0;   // 进入编译队列的时间(微秒)，用于阶段记录
+    std::atomic<CompilationStatus> status{CompilationStatus::FETCHING};
+    std::atomic<int> progress{0};
+    std::atomic<bool> progress_reported{false};   // progress 来自构建输出中的进度标记
+    std::atomic<size_t> units_completed{0};       // 构建输出报告的已完成步骤数
+    std::atomic<size_t> units_total{0};           // 构建输出报告的步骤总数，0 表示未知
+    std::atomic<int> exit_code{-1};
+    std::shared_ptr<OutputBuffer> output;   // 构建输出，只通过 std::atomic_load/atomic_store 访问
+    std::atomic<bool> output_spilled{false};   // 构建输出已写入任务日志，output 已释放
+    std::atomic<time_t> started_at{0};
+    std::atomic<time_t> completed_at{0};
+    std::atomic<time_t> paused_at{0};        // 最近一次暂停的时间
+    std::atomic<time_t> paused_seconds{0};   // 累计暂停时长，不计入构建耗时
     std::future<int> future;
-    std::atomic<bool> cancelled;
+    std::atomic<bool> cancelled{false};
+    std::atomic<pid_t> process_group{0};   // 构建进程组ID，未运行时为0
+    std::mutex process_mutex;   // 回收构建进程与向其进程组发信号互斥，信号不会发给已回收并被复用的进程组ID
+    std::string work_dir;    // 指定的工作目录（如热构建目录），为空时使用 build_directory
+    std::string cache_key;   // 结果缓存键，为空表示不缓存
+    std::atomic<bool> cached{false};     // 结果是否来自缓存
+    std::optional<ResourceUsage> usage;  // 构建的资源用量，在 cgroup 中运行时于发布结束状态前写入
+    std::optional<ProcessUsage> rusage;  // 构建进程的 wait4 资源用量，于发布结束状态前写入
+    JobTrace trace;                      // 各阶段的起止时间
 };
 
 // 编译任务状态信息（用于API返回）
@@ -43,9 +101,19 @@ struct JobStatusInfo {
     std::string job_id;
     std::string status;
     int progress;
+    std::optional<size_t> units_completed;   // 构建输出报告的已完成步骤数
+    std::optional<size_t> units_total;       // 构建输出报告的步骤总数
     time_t started_at;
     time_t completed_at;
+    time_t paused_seconds;
     bool completed;
+    bool cached;
+    std::optional<size_t> queue_position;          // 排队中任务的出队位置，0 表示下一个
+    std::optional<time_t> estimated_wait_seconds;  // 排队中任务的预计等待时间
+    std::optional<time_t> estimated_duration_seconds;   // 按历史估计的构建耗时（中位数）
+    std::optional<time_t> estimated_duration_p90_seconds;   // 按历史估计的构建耗时上限（90 分位）
+    std::optional<time_t> eta_p90;                 // 按耗时上限推算的最晚完成时间
+    std::optional<time_t> eta;                     // 预计完成时间
 };
 
 // 编译任务结果信息（用于API返回）
@@ -56,52 +124,210 @@ struct JobResultInfo {
     std::string output;
     time_t completed_at;
     bool completed;
+    bool cached;
+    std::optional<ResourceUsage> usage;   // 构建的资源用量
+    std::optional<ProcessUsage> rusage;   // 构建进程的资源用量
+    std::vector<PhaseSpan> phases;        // 各阶段的起止时间
 };
 
+// 任务阶段记录（用于导出时间线）
+struct JobTraceInfo {
+    std::string job_id;
+    std::vector<PhaseSpan> phases;
+};
+
+// 任务编译结束回调
+using CompletionListener = std::function<void(const CompilationJob&)>;
+
 class CompilationHandler {
 public:
-    CompilationHandler(const std::string& build_root_path, size_t max_concurrent_jobs = 4);
+    CompilationHandler(const std::string& build_root_path, size_t max_concurrent_jobs = 4,
+                       const CompilationOptions& options = {});
     ~CompilationHandler();
 
     // 创建新的编译任务
     std::string create_job(const std::string& repo_path, const nlohmann::json& config);
 
+    // 创建处于获取阶段的编译任务，代码就绪后再调用 start_job 入队
+    std::string create_fetching_job(const nlohmann::json& config);
+
+    // 代码就绪，将获取阶段的任务加入编译队列；任务已取消或不存在时返回false
+    bool start_job(const std::string& job_id, const std::string& repo_path, const std::string& cache_key = "",
+                   const std::string& work_dir = "");
+
+    // 以缓存结果直接完成获取阶段的任务，不执行构建；任务已取消或不存在时返回false
+    bool complete_cached_job(const std::string& job_id, int exit_code, const std::string& output);
+
+    // 注册任务结束回调，构建结束或排队中被取消时调用
+    void add_completion_listener(CompletionListener listener);
+
+    // 移除所有任务结束回调，回调所属对象析构前调用
+    void clear_completion_listeners();
+
+    // 取出重启前未完成的任务，需要重新获取代码；只在启动时调用一次
+    std::vector<std::string> take_recovered_jobs();
+
+    // 将获取阶段失败的任务标记为失败
+    void fail_job(const std::string& job_id, const std::string& message);
+
+    // 任务是否存在，只查任务表，不计算状态
+    bool has_job(const std::string& job_id);
+
     // 获取任务状态
     std::optional<JobStatusInfo> get_job_status(const std::string& job_id);
 
     // 获取任务结果
     std::optional<JobResultInfo> get_job_result(const std::string& job_id);
 
+    // 记录任务一个阶段的起止时间，用于获取流水线等外部阶段
+    void record_phase(const std::string& job_id, const std::string& name, int64_t start_us, int64_t end_us);
+
+    // 获取与时间范围(微秒)有重叠的任务的阶段记录，按开始时间排列
+    std::vector<JobTraceInfo> get_job_traces(int64_t from_us, int64_t to_us);
+
+    // 排队中的任务数，不加锁
+    size_t queued_job_count();
+
+    // 正在运行（未暂停）的任务数，不加锁
+    size_t running_job_count() const;
+
+    // 获取任务的编译配置
+    std::optional<nlohmann::json> get_job_config(const std::string& job_id);
+
+    // 获取任务的输出缓冲，用于边构建边读取
+    std::shared_ptr<OutputBuffer> get_job_output(const std::string& job_id);
+
     // 取消任务
     bool cancel_job(const std::string& job_id);
 
     // 清理过期任务
     void clean_expired_jobs(time_t max_age_seconds);
 
+    // 获取未结束任务正在使用的代码目录
+    std::unordered_set<std::string> active_repo_paths();
+
+    // 列出可淘汰的构建目录，未结束任务的目录标记为使用中
+    std::vector<CacheEntry> cache_entries();
+
+    // 删除已结束任务的构建目录；任务仍在进行时返回false
+    bool evict(const std::string& path);
+
+    // 获取构建根目录
+    const std::string& build_root_path() const { return build_root_path_; }
+
+    // 获取任务独立的工作目录，构建在其中进行
+    std::string build_directory(const std::string& job_id) const { return build_root_path_ + "/" + job_id; }
+
 private:
     std::string build_root_path_;
     size_t max_concurrent_jobs_;
-    std::unordered_map<std::string, std::unique_ptr<CompilationJob>> jobs_;
-    std::queue<std::string> job_queue_;
+    CompilationOptions options_;
+    JobTable jobs_;
+    FairShareQueue job_queue_;
+    // 排队任务的出队位置和预计等待时间
+    struct QueueEstimate {
+        size_t position;
+        time_t wait_seconds;
+    };
+    using QueueEstimates = std::unordered_map<std::string, QueueEstimate>;
+
+    // 推算出队顺序的最小间隔，队列频繁变化时限制重算频率
+    static constexpr std::chrono::milliseconds kQueueEstimateMinInterval{200};
+
+    // 队列不变时排队估计的最长有效期：出队顺序随排队时间折减而变化，运行中任务的剩余耗时也在减少
+    static constexpr std::chrono::seconds kQueueEstimateMaxAge{2};
+
+    std::shared_ptr<const QueueEstimates> queue_estimates_;   // 最近发布的排队估计，只通过 std::atomic_load/atomic_store 访问
+    std::atomic<bool> queue_order_stale_{false};   // 队列在发布排队估计后有变化
+    std::thread queue_publisher_thread_;
+    std::mutex publisher_mutex_;                   // 只用于发布线程等待
+    std::condition_variable publisher_condition_;
+    std::atomic<size_t> queued_jobs_{0};           // 排队中的任务数，持锁修改，可不加锁读取
+    std::atomic<size_t> running_jobs_{0};    // 正在运行（未暂停）的任务数，不超过 max_concurrent_jobs_；持锁修改，可不加锁读取
+    std::deque<std::string> paused_jobs_;    // 被抢占的任务，按暂停先后排列
+    DurationEstimator duration_estimator_;
     std::vector<std::thread> worker_threads_;
-    std::mutex jobs_mutex_;
+    std::mutex schedule_mutex_;   // 保护调度状态：队列、名额、暂停列表以及获取阶段任务的状态转换，持有期间不做文件系统操作
     std::condition_variable job_condition_;
     std::atomic<bool> stop_workers_;
+    CoreScheduler core_scheduler_;
+    std::vector<CompletionListener> completion_listeners_;
+    std::mutex listeners_mutex_;   // 保护 completion_listeners_，回调执行期间持有
+    std::unique_ptr<JobJournal> journal_;       // 为空表示不持久化任务
+    std::unique_ptr<CgroupManager> cgroups_;    // 为空表示构建不受资源上限约束
+    std::vector<std::string> recovered_jobs_;   // 重启前未完成的任务
 
     // 生成唯一任务ID
     std::string generate_job_id();
 
+    // 按编译配置构造获取阶段的任务
+    std::shared_ptr<CompilationJob> make_job(const std::string& job_id, const nlohmann::json& config) const;
+
+    // 从任务日志恢复任务：已结束的任务保留结果，未结束的任务等待重新获取
+    void recover_jobs();
+
+    // 把已结束任务的最终状态写入任务日志，输出落盘后释放内存中的缓冲；调用方不得持有 schedule_mutex_
+    void persist_finished(CompilationJob& job);
+
     // 工作线程函数
     void worker_thread();
 
-    // 执行编译任务
-    int execute_compilation(CompilationJob& job);
+    // 执行编译任务，构建绑定到 cpus 并以相同的并行度运行
+    int execute_compilation(CompilationJob& job, const std::vector<int>& cpus);
+
+    // 排队中的任务数
+    size_t pending_jobs();
+
+    // 是否可以开始一个排队任务：有空闲名额，且有被暂停的任务时只放行高优先级任务；调用方须持有 schedule_mutex_
+    bool can_dispatch() const;
+
+    // 高优先级任务没有空闲名额时，暂停一个优先级最低、启动最晚的运行中任务；调用方须持有 schedule_mutex_
+    void preempt_for(const CompilationJob& urgent);
+
+    // 名额空出且没有高优先级任务排队时恢复被暂停的任务；调用方须持有 schedule_mutex_
+    void resume_paused();
+
+    // 工作线程结束一个任务后归还名额
+    void finish_job(const CompilationJob& job);
+
+    // 记录构建耗时，用于调度和估算完成时间
+    void record_duration(const CompilationJob& job);
+
+    // 按构建输出中的进度更新任务
+    void update_progress(CompilationJob& job, const BuildProgress& progress);
+
+    // 估算运行中任务的剩余耗时：构建输出报告了进度时按已用时间外推，并随进度增加逐步取代历史耗时
+    std::optional<double> remaining_seconds(const CompilationJob& job, time_t now);
+
+    // 预计最短的任务优先，排队越久折减越多；只使用入队时记录的估计，不查询任务表
+    size_t select_shortest(const std::deque<QueuedJob>& jobs) const;
+
+    // 按已发布的排队估计取任务的出队位置和等待时间，不加锁；尚未发布时返回空
+    std::optional<time_t> estimate_wait(const std::string& job_id, std::optional<size_t>& position);
+
+    // 队列变化后记录排队数并通知发布线程；调用方须持有 schedule_mutex_
+    void queue_changed();
+
+    // 发布线程函数：队列变化后重新推算排队估计，不在请求和调度路径上计算
+    void queue_publisher_thread();
+
+    // 在队列副本上推算出队顺序和等待时间并发布，只在复制队列时持有 schedule_mutex_
+    void publish_queue_estimates();
+
+    // 调用任务结束回调，调用方不得持有 schedule_mutex_
+    void notify_completion(const CompilationJob& job);
+
+    // 解析编译配置，返回交给 /bin/sh -c 执行的构建命令
+    std::string get_compile_command(const nlohmann::json& config, size_t parallelism);
+
+    // 解析编译配置中的环境变量
+    std::vector<std::pair<std::string, std::string>> get_environment(const nlohmann::json& config);
 
-    // 解析编译配置
-    std::string get_compile_command(const std::string& repo_path, const nlohmann::json& config);
+    // 任务的资源上限：租户上限或默认上限，任务配置中的 limits 只能在此基础上收紧
+    ResourceLimits job_limits(const CompilationJob& job) const;
 
-    // 创建构建目录
-    std::string create_build_directory(const std::string& job_id);
+    // 准备任务工作目录，尚未填充时以代码目录为模板填充
+    std::string prepare_build_directory(CompilationJob& job);
 };
 
 } // namespace lisa::server
@@ -0,0 +1,149 @@
+#include "compile_unit.h"
+#include <set>
+#include <cstdlib>
+#include <filesystem>
+#include <unistd.h>
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+using namespace lisa::server;
+
+namespace {
+
+// 建立连接的超时(秒)，节点不可达时尽快退回本地编译
+constexpr time_t kConnectTimeoutSeconds = 2;
+
+// 等待编译结果的超时(秒)
+constexpr time_t kCompileTimeoutSeconds = 600;
+
+// 后面跟一个独立参数值、且可以远程使用的选项
+const std::set<std::string> kRemoteOptionsWithValue = {"--param", "-target", "-arch"};
+
+// 可以远程使用的参数前缀；-f 参数另行检查
+const char* const kAllowedPrefixes[] = {"-m", "-W", "-O", "-g", "-std=", "-pedantic", "-w", "-ansi", "-pipe"};
+
+// 会读写额外文件或加载代码的参数前缀，优先于允许的前缀
+const char* const kDeniedPrefixes[] = {
+    "-fplugin", "-fpass-plugin", "-fprofile", "-fdump", "-fstack-usage", "-fcallgraph-info", "-fmodule",
+    "-fprebuilt-module", "-fimplicit-module", "-fsanitize-blacklist", "-fsanitize-ignorelist", "-fcoverage",
+    "-ftest-coverage", "-fopt-info", "-ftime-trace", "-fsave-optimization-record", "-foptimization-record",
+    "-fcrash-diagnostics", "-fembed-offload", "-Wl,", "-Wa,", "-Wp,"
+};
+
+// 可以远程使用的带值 -f 参数(等号前的部分)，值是枚举、数字或前缀映射，不会被当作要读写的文件
+const std::set<std::string> kAllowedValueFlags = {
+    "-fvisibility", "-fdiagnostics-color", "-fmessage-length", "-fmax-errors", "-ftemplate-depth",
+    "-fconstexpr-depth", "-fconstexpr-steps", "-fabi-version", "-fcf-protection", "-ftls-model",
+    "-fexcess-precision", "-ffp-contract", "-ffp-model", "-ffp-exception-behavior", "-flto", "-flto-partition",
+    "-fsanitize", "-fno-sanitize", "-fsanitize-recover", "-fno-sanitize-recover", "-fsanitize-trap",
+    "-fno-sanitize-trap", "-fzero-call-used-regs", "-ftrivial-auto-var-init", "-finline-limit",
+    "-fexec-charset", "-finput-charset", "-fwide-exec-charset", "-fpatchable-function-entry",
+    "-falign-functions", "-falign-loops", "-falign-jumps", "-falign-labels", "-fdebug-prefix-map",
+    "-ffile-prefix-map", "-fmacro-prefix-map", "-fdebug-compilation-dir", "-fstrict-flex-arrays",
+    "-fopenmp-version"
+};
+
+// -f 参数：不带值的开关除拒绝列表外都允许，带值的只允许列出的参数
+bool f_option_allowed(const std::string& arg) {
+    size_t eq = arg.find('=');
+    return eq == std::string::npos || kAllowedValueFlags.count(arg.substr(0, eq)) > 0;
+}
+
+bool has_prefix(const std::string& arg, const char* prefix) {
+    return arg.rfind(prefix, 0) == 0;
+}
+
+} // namespace
+
+std::string lisa::server::find_program(const std::string& name) {
+    if (name.find('/') != std::string::npos) {
+        return name;
+    }
+    const char* path = std::getenv("PATH");
+    std::string dirs = path != nullptr ? path : "/usr/bin:/bin";
+    size_t start = 0;
+    while (start <= dirs.size()) {
+        size_t end = dirs.find(':', start);
+        std::string dir = dirs.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        std::string candidate = (dir.empty() ? "." : dir) + "/" + name;
+        if (access(candidate.c_str(), X_OK) == 0) {
+            return candidate;
+        }
+        if (end == std::string::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+    return "";
+}
+
+std::string lisa::server::unit_language(const std::string& source_path) {
+    static const std::set<std::string> c_extensions = {".c"};
+    static const std::set<std::string> cxx_extensions = {".cc", ".cpp", ".cxx", ".c++", ".C"};
+
+    std::string extension = fs::path(source_path).extension().string();
+    if (c_extensions.count(extension) > 0) return "c";
+    if (cxx_extensions.count(extension) > 0) return "c++";
+    return "";
+}
+
+bool lisa::server::remote_args_allowed(const std::vector<std::string>& args) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (kRemoteOptionsWithValue.count(arg) > 0) {
+            if (i + 1 >= args.size()) return false;
+            ++i;
+            continue;
+        }
+
+        for (const char* prefix : kDeniedPrefixes) {
+            if (has_prefix(arg, prefix)) return false;
+        }
+        bool allowed = has_prefix(arg, "-f") && f_option_allowed(arg);
+        for (const char* prefix : kAllowedPrefixes) {
+            allowed |= has_prefix(arg, prefix);
+        }
+        if (!allowed) return false;
+    }
+    return true;
+}
+
+std::optional<CompileUnitResult> lisa::server::send_compile_unit(const std::string& peer,
+                                                                 const CompileUnitRequest& request) {
+    httplib::Client client("http://" + peer);
+    client.set_connection_timeout(kConnectTimeoutSeconds, 0);
+    client.set_read_timeout(kCompileTimeoutSeconds, 0);
+    client.set_write_timeout(kCompileTimeoutSeconds, 0);
+
+    // 预处理结果不一定是合法的UTF-8，以multipart二进制字段发送
+    httplib::MultipartFormDataItems items = {
+        {"compiler", request.compiler, "", ""},
+        {"version", request.version, "", ""},
+        {"language", request.language, "", ""},
+        {"args", json(request.args).dump(), "", "application/json"},
+        {"working_dir", request.working_dir, "", ""},
+        {"source", request.source, "unit", "application/octet-stream"}
+    };
+
+    auto response = client.Post("/api/compile-unit", items);
+    if (!response || response->status != 200) {
+        return std::nullopt;
+    }
+
+    // 响应体依次为诊断输出和目标文件，诊断输出长度由响应头给出
+    try {
+        CompileUnitResult result;
+        result.exit_code = std::stoi(response->get_header_value("X-Lisa-Exit-Code"));
+        size_t diagnostics_length = std::stoul(response->get_header_value("X-Lisa-Diagnostics-Length"));
+        if (diagnostics_length > response->body.size()) {
+            return std::nullopt;
+        }
+        result.diagnostics = response->body.substr(0, diagnostics_length);
+        result.object = response->body.substr(diagnostics_length);
+        return result;
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef COMPILE_UNIT_H
+#define COMPILE_UNIT_H
+
+#include <string>
+#include <vector>
+#include <optional>
+
+namespace lisa::server {
+
+// 发往其他节点编译的预处理单元
+struct CompileUnitRequest {
+    std::string compiler;            // 编译器名称，由接收节点在 PATH 中查找
+    std::string version;             // 编译器 --version 输出的第一行，与接收节点不一致时被拒绝
+    std::string language;            // c 或 c++
+    std::vector<std::string> args;   // 代码生成参数，不含预处理、输入和输出参数
+    std::string working_dir;         // 发起方的工作目录，调试信息中的编译目录映射到这里
+    std::string source;              // 预处理结果
+};
+
+// 编译单元的编译结果
+struct CompileUnitResult {
+    int exit_code = -1;
+    std::string diagnostics;   // 编译器的标准输出和标准错误
+    std::string object;        // 目标文件内容，编译失败时为空
+};
+
+// 按 PATH 查找可执行文件，找不到时返回空
+std::string find_program(const std::string& name);
+
+// 按源文件扩展名得到可远程编译的语言（c 或 c++），其他语言返回空
+std::string unit_language(const std::string& source_path);
+
+// 检查代码生成参数能否在其他节点上使用：拒绝读写额外文件或加载插件的参数
+bool remote_args_allowed(const std::vector<std::string>& args);
+
+// 把编译单元发送到节点（host:port）编译，节点不可达、繁忙或拒绝时返回空
+std::optional<CompileUnitResult> send_compile_unit(const std::string& peer, const CompileUnitRequest& request);
+
+} // namespace lisa::server
+
+#endif // COMPILE_UNIT_H
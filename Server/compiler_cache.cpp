@@ -0,0 +1,107 @@
+#include "compiler_cache.h"
+#include <git2.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+namespace fs = std::filesystem;
+using namespace lisa::server;
+
+namespace {
+
+// 临时文件名后缀，同一进程内和不同进程间都不重复
+std::string temp_suffix() {
+    static unsigned sequence = 0;
+    return ".tmp-" + std::to_string(getpid()) + "-" + std::to_string(++sequence);
+}
+
+} // namespace
+
+CompilerCache::CompilerCache(const std::string& cache_path) : cache_path_(cache_path) {
+    fs::create_directories(cache_path_);
+}
+
+std::string CompilerCache::hash(const std::string& data) {
+    git_oid oid;
+    git_odb_hash(&oid, data.data(), data.size(), GIT_OBJECT_BLOB);
+    char hex[GIT_OID_HEXSZ + 1];
+    git_oid_tostr(hex, sizeof(hex), &oid);
+    return hex;
+}
+
+std::string CompilerCache::entry_path(const std::string& key) const {
+    return cache_path_ + "/" + key.substr(0, 2) + "/" + key;
+}
+
+bool CompilerCache::fetch(const std::string& key, const std::string& object_path, std::string& diagnostics) {
+    std::string path = entry_path(key);
+    std::ifstream diagnostics_file(path + "/stderr", std::ios::binary);
+    if (!diagnostics_file.is_open()) {
+        return false;
+    }
+
+    // 先复制到临时文件再改名，构建系统不会看到写了一半的目标文件
+    std::error_code ec;
+    std::string temp_path = object_path + temp_suffix();
+    fs::copy_file(path + "/object", temp_path, fs::copy_options::overwrite_existing, ec);
+    if (!ec) {
+        fs::rename(temp_path, object_path, ec);
+    }
+    if (ec) {
+        fs::remove(temp_path, ec);
+        return false;
+    }
+
+    diagnostics.assign(std::istreambuf_iterator<char>(diagnostics_file), std::istreambuf_iterator<char>());
+
+    // 刷新修改时间作为LRU的最后使用时间
+    utime((path + "/stderr").c_str(), nullptr);
+    return true;
+}
+
+void CompilerCache::store(const std::string& key, const std::string& object_path, const std::string& diagnostics) {
+    std::string path = entry_path(key);
+    std::string temp_path = path + temp_suffix();
+
+    std::error_code ec;
+    fs::create_directories(temp_path, ec);
+    fs::copy_file(object_path, temp_path + "/object", ec);
+    if (!ec) {
+        std::ofstream diagnostics_file(temp_path + "/stderr", std::ios::binary);
+        diagnostics_file << diagnostics;
+        if (!diagnostics_file) {
+            ec = std::make_error_code(std::errc::io_error);
+        }
+    }
+
+    // 写完整后再改名；并发编译同一单元时保留先完成的一份
+    if (!ec) {
+        fs::rename(temp_path, path, ec);
+    }
+    if (ec) {
+        fs::remove_all(temp_path, ec);
+    }
+}
+
+std::vector<CacheEntry> CompilerCache::cache_entries() {
+    std::vector<CacheEntry> entries;
+    std::error_code ec;
+    for (const auto& shard : fs::directory_iterator(cache_path_, ec)) {
+        if (!shard.is_directory()) continue;
+        for (const auto& entry : fs::directory_iterator(shard.path(), ec)) {
+            struct stat st;
+            if (stat((entry.path() / "stderr").c_str(), &st) == 0) {
+                entries.push_back({entry.path().string(), st.st_mtime, false});
+            }
+        }
+    }
+    return entries;
+}
+
+bool CompilerCache::evict(const std::string& path) {
+    std::error_code ec;
+    return fs::remove_all(path, ec) > 0;
+}
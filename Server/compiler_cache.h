@@ -0,0 +1,43 @@
+#ifndef COMPILER_CACHE_H
+#define COMPILER_CACHE_H
+
+#include <string>
+#include <vector>
+#include "cache_entry.h"
+
+namespace lisa::server {
+
+// 编译器输出缓存：以预处理结果、编译器和编译参数的哈希为键保存目标文件及编译器的诊断输出。
+// 编译器包装程序 lisa_cc 读写缓存，服务器只负责按配额淘汰
+class CompilerCache {
+public:
+    explicit CompilerCache(const std::string& cache_path);
+
+    // 计算内容的哈希，作为缓存键
+    static std::string hash(const std::string& data);
+
+    // 命中时把目标文件复制到 object_path 并取出诊断输出，未命中时返回false
+    bool fetch(const std::string& key, const std::string& object_path, std::string& diagnostics);
+
+    // 保存编译产生的目标文件和诊断输出，已存在时保持原结果
+    void store(const std::string& key, const std::string& object_path, const std::string& diagnostics);
+
+    // 列出缓存条目
+    std::vector<CacheEntry> cache_entries();
+
+    // 删除缓存条目
+    bool evict(const std::string& path);
+
+    // 缓存根目录
+    const std::string& cache_path() const { return cache_path_; }
+
+private:
+    std::string cache_path_;
+
+    // 缓存条目目录：<cache_path>/<键前两位>/<键>
+    std::string entry_path(const std::string& key) const;
+};
+
+} // namespace lisa::server
+
+#endif // COMPILER_CACHE_H
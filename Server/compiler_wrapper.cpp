@@ -0,0 +1,434 @@
+// lisa_cc：编译器包装程序，用法为 lisa_cc <编译器> <参数...>。
+// 单个源文件编译为目标文件（-c）时，以预处理结果、编译器和编译参数的哈希查找编译器输出缓存，
+// 命中时直接复制目标文件，未命中时在本机或 LISA_REMOTE_PEERS 中的节点上编译并保存结果；
+// 其他调用原样交给编译器
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <optional>
+#include <random>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <git2.h>
+#include "compiler_cache.h"
+#include "compile_unit.h"
+
+extern char** environ;
+
+namespace fs = std::filesystem;
+using namespace lisa::server;
+
+namespace {
+
+// 哈希格式版本，格式变化时修改，旧条目自然失效
+const char* const kHashVersion = "lisa-cc-1";
+
+// 后面跟一个独立参数值的选项
+const std::set<std::string> kOptionsWithValue = {
+    "-o", "-MF", "-MT", "-MQ", "-I", "-D", "-U", "-include", "-imacros", "-isystem", "-iquote", "-idirafter",
+    "-iprefix", "-iwithprefix", "-isysroot", "-x", "-arch", "-target", "--param", "-Xclang", "-Xpreprocessor",
+    "-Xassembler", "-Xlinker", "-aux-info", "-L", "-l"
+};
+
+// 只用于生成依赖文件、不影响目标文件内容的选项，不参与哈希
+const std::set<std::string> kDependencyOptions = {"-MF", "-MT", "-MQ"};
+
+// 只作用于预处理的选项，远程编译预处理结果时不需要
+const std::set<std::string> kPreprocessorOptions = {
+    "-I", "-D", "-U", "-include", "-imacros", "-isystem", "-iquote", "-idirafter", "-iprefix", "-iwithprefix",
+    "-isysroot", "-MF", "-MT", "-MQ"
+};
+
+// 只作用于预处理的单个参数
+bool preprocessor_only(const std::string& arg) {
+    static const char* const prefixes[] = {
+        "-I", "-D", "-U", "-M", "-include", "-imacros", "-isystem", "-iquote", "-idirafter", "-isysroot", "--sysroot",
+        "-nostdinc"
+    };
+    for (const char* prefix : prefixes) {
+        if (arg.rfind(prefix, 0) == 0) return true;
+    }
+    return false;
+}
+
+// 会产生额外输出文件或改变输出种类、无法缓存的选项
+bool uncacheable_option(const std::string& arg) {
+    static const std::set<std::string> exact = {
+        "-E", "-S", "-M", "-MM", "-", "-fsyntax-only", "--coverage", "-fprofile-arcs", "-ftest-coverage"
+    };
+    return exact.count(arg) > 0 || arg.rfind("-save-temps", 0) == 0 || arg.rfind("-fprofile-generate", 0) == 0 ||
+           arg.rfind("-Wp,", 0) == 0 || arg.rfind("@", 0) == 0;
+}
+
+// 按扩展名判断是否为源文件
+bool is_source_file(const std::string& arg) {
+    static const std::set<std::string> extensions = {
+        ".c", ".cc", ".cpp", ".cxx", ".c++", ".C", ".m", ".mm", ".i", ".ii", ".s", ".S"
+    };
+    return arg.rfind('-', 0) != 0 && extensions.count(fs::path(arg).extension().string()) > 0;
+}
+
+// 解析后的编译命令
+struct Invocation {
+    std::string source;
+    std::string output;
+    std::vector<std::string> hashed_args;       // 参与哈希的参数
+    std::vector<std::string> preprocess_args;   // 预处理命令的参数（不含编译器）
+    std::vector<std::string> remote_args;       // 远程编译预处理结果时的参数
+    bool explicit_language = false;             // 通过 -x 指定了语言，不远程编译
+};
+
+// 解析编译参数，不可缓存时返回false
+bool parse_invocation(const std::vector<std::string>& args, Invocation& invocation) {
+    bool compile_only = false;
+    bool dependency_file = false;
+    bool dependency_target = false;
+    bool dependency_output = false;
+
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (uncacheable_option(arg)) {
+            return false;
+        }
+
+        if (kOptionsWithValue.count(arg) > 0) {
+            if (i + 1 >= args.size()) {
+                return false;
+            }
+            const std::string& value = args[++i];
+            if (arg == "-o") {
+                invocation.output = value;
+                continue;
+            }
+            dependency_target |= arg == "-MT" || arg == "-MQ";
+            dependency_output |= arg == "-MF";
+            invocation.explicit_language |= arg == "-x";
+            invocation.preprocess_args.push_back(arg);
+            invocation.preprocess_args.push_back(value);
+            if (kDependencyOptions.count(arg) == 0) {
+                invocation.hashed_args.push_back(arg);
+                invocation.hashed_args.push_back(value);
+            }
+            if (kPreprocessorOptions.count(arg) == 0) {
+                invocation.remote_args.push_back(arg);
+                invocation.remote_args.push_back(value);
+            }
+            continue;
+        }
+
+        if (arg == "-c") {
+            compile_only = true;
+            continue;
+        }
+        if (is_source_file(arg)) {
+            if (!invocation.source.empty()) {
+                return false;
+            }
+            invocation.source = arg;
+            invocation.preprocess_args.push_back(arg);
+            continue;
+        }
+
+        dependency_file |= arg == "-MD" || arg == "-MMD";
+        invocation.preprocess_args.push_back(arg);
+        invocation.hashed_args.push_back(arg);
+        if (!preprocessor_only(arg)) {
+            invocation.remote_args.push_back(arg);
+        }
+    }
+
+    if (!compile_only || invocation.source.empty() || invocation.output == "-") {
+        return false;
+    }
+    if (invocation.output.empty()) {
+        invocation.output = fs::path(invocation.source).filename().replace_extension(".o").string();
+    }
+
+    // 依赖文件由预处理步骤生成，命中缓存时同样是最新的。预处理输出到临时文件，
+    // 依赖文件的目标名和路径不能再按 -o 推导，需要显式给出
+    if (dependency_file && !dependency_target) {
+        invocation.preprocess_args.push_back("-MQ");
+        invocation.preprocess_args.push_back(invocation.output);
+    }
+    if (dependency_file && !dependency_output) {
+        invocation.preprocess_args.push_back("-MF");
+        invocation.preprocess_args.push_back(fs::path(invocation.output).replace_extension(".d").string());
+    }
+    return true;
+}
+
+// 把文本中出现的 basedir 替换为 "."，不同任务目录中的相同源码得到相同的哈希
+std::string rewrite_basedir(std::string text, const std::string& basedir) {
+    if (basedir.empty()) {
+        return text;
+    }
+    size_t pos = 0;
+    while ((pos = text.find(basedir, pos)) != std::string::npos) {
+        text.replace(pos, basedir.size(), ".");
+        pos += 1;
+    }
+    return text;
+}
+
+// 运行命令，输出写入 output（为空时丢弃）并可选地转发到标准错误，返回退出码
+int run(const std::vector<std::string>& argv, std::string* output, bool forward) {
+    int output_pipe[2];
+    if (pipe2(output_pipe, O_CLOEXEC) != 0) {
+        return -1;
+    }
+
+    // 编译器留在包装程序所在的进程组中，任务取消或暂停时随整个构建进程组一起收到信号
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, output_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, output_pipe[1], STDERR_FILENO);
+
+    std::vector<char*> raw;
+    for (const auto& arg : argv) raw.push_back(const_cast<char*>(arg.c_str()));
+    raw.push_back(nullptr);
+
+    pid_t pid;
+    int error = posix_spawn(&pid, raw[0], &actions, nullptr, raw.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(output_pipe[1]);
+    if (error != 0) {
+        close(output_pipe[0]);
+        return -1;
+    }
+
+    char chunk[16384];
+    for (;;) {
+        ssize_t n = read(output_pipe[0], chunk, sizeof(chunk));
+        if (n > 0) {
+            if (output != nullptr) output->append(chunk, static_cast<size_t>(n));
+            if (forward) {
+                ssize_t ignored = write(STDERR_FILENO, chunk, static_cast<size_t>(n));
+                (void)ignored;
+            }
+        } else if (n == 0 || errno != EINTR) {
+            break;
+        }
+    }
+    close(output_pipe[0]);
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return -1;
+}
+
+// 不使用缓存，直接以编译器替换当前进程
+int exec_compiler(std::vector<std::string> argv) {
+    std::vector<char*> raw;
+    for (auto& arg : argv) raw.push_back(arg.data());
+    raw.push_back(nullptr);
+    execv(raw[0], raw.data());
+    std::fprintf(stderr, "lisa_cc: failed to execute %s: %s\n", raw[0], std::strerror(errno));
+    return 127;
+}
+
+// 按分隔符拆分环境变量的值，忽略空项
+std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find(separator, start);
+        std::string item = text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        if (!item.empty()) items.push_back(item);
+        if (end == std::string::npos) break;
+        start = end + 1;
+    }
+    return items;
+}
+
+// 先写临时文件再改名，构建系统不会看到写了一半的目标文件
+bool write_object(const std::string& path, const std::string& content) {
+    std::string temp_path = path + ".tmp-" + std::to_string(getpid());
+    {
+        std::ofstream file(temp_path, std::ios::binary);
+        file << content;
+        if (!file) {
+            std::error_code ec;
+            fs::remove(temp_path, ec);
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(temp_path, path, ec);
+    return !ec;
+}
+
+// 选择编译位置：本机与每个节点各占一份，均匀随机；返回空表示在本机编译
+std::optional<std::string> choose_peer(const std::string& compiler_name, const Invocation& invocation) {
+    const char* peers_env = std::getenv("LISA_REMOTE_PEERS");
+    const char* compilers_env = std::getenv("LISA_REMOTE_COMPILERS");
+    if (peers_env == nullptr || compilers_env == nullptr || invocation.explicit_language ||
+        unit_language(invocation.source).empty() || !remote_args_allowed(invocation.remote_args)) {
+        return std::nullopt;
+    }
+
+    std::vector<std::string> compilers = split(compilers_env, ',');
+    if (std::find(compilers.begin(), compilers.end(), compiler_name) == compilers.end()) {
+        return std::nullopt;
+    }
+
+    std::vector<std::string> peers = split(peers_env, ',');
+    std::random_device random;
+    size_t slot = std::uniform_int_distribution<size_t>(0, peers.size())(random);
+    if (slot == 0) {
+        return std::nullopt;
+    }
+    return peers[slot - 1];
+}
+
+// 在节点上编译预处理结果，节点不可用或编译失败时返回空
+std::optional<CompileUnitResult> compile_remote(const std::string& peer, const std::string& compiler,
+                                                const std::string& compiler_name, const Invocation& invocation,
+                                                std::string preprocessed) {
+    std::string version;
+    if (run({compiler, "--version"}, &version, false) != 0) {
+        return std::nullopt;
+    }
+
+    std::error_code ec;
+    CompileUnitRequest request;
+    request.compiler = compiler_name;
+    request.version = version.substr(0, version.find('\n'));
+    request.language = unit_language(invocation.source);
+    request.args = invocation.remote_args;
+    request.working_dir = fs::current_path(ec).string();
+    request.source = std::move(preprocessed);
+
+    auto result = send_compile_unit(peer, request);
+    if (!result || result->exit_code != 0) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // 跳过指向自身的参数：CC 和 CMAKE_*_COMPILER_LAUNCHER 同时设置时会出现两层包装
+    std::error_code ec;
+    fs::path self = fs::read_symlink("/proc/self/exe", ec);
+    int first = 1;
+    while (first < argc && fs::equivalent(find_program(argv[first]), self, ec)) {
+        ++first;
+    }
+    if (first >= argc) {
+        std::fprintf(stderr, "usage: lisa_cc <compiler> [args...]\n");
+        return 2;
+    }
+
+    std::string compiler = find_program(argv[first]);
+    if (compiler.empty()) {
+        std::fprintf(stderr, "lisa_cc: compiler not found: %s\n", argv[first]);
+        return 127;
+    }
+    std::vector<std::string> args(argv + first + 1, argv + argc);
+    std::vector<std::string> compile_argv = {compiler};
+    compile_argv.insert(compile_argv.end(), args.begin(), args.end());
+
+    const char* cache_env = std::getenv("LISA_CACHE_DIR");
+    std::string cache_dir = cache_env != nullptr ? cache_env : "";
+    std::string compiler_name = fs::path(argv[first]).filename().string();
+    Invocation invocation;
+    if (!parse_invocation(args, invocation)) {
+        return exec_compiler(compile_argv);
+    }
+    std::optional<std::string> peer = choose_peer(compiler_name, invocation);
+    if (cache_dir.empty() && !peer) {
+        return exec_compiler(compile_argv);
+    }
+
+    std::optional<CompilerCache> cache;
+    std::string temp_dir = fs::temp_directory_path(ec).string();
+    if (!cache_dir.empty()) {
+        git_libgit2_init();
+        cache.emplace(cache_dir);
+        temp_dir = cache->cache_path() + "/tmp";
+        fs::create_directories(temp_dir, ec);
+    }
+
+    // 预处理到临时文件；预处理失败时交给编译器报告错误
+    std::string temp_template = temp_dir + "/cpp-XXXXXX";
+    int temp_fd = mkstemp(temp_template.data());
+    if (temp_fd < 0) {
+        return exec_compiler(compile_argv);
+    }
+    close(temp_fd);
+    const std::string& preprocessed_path = temp_template;
+
+    std::vector<std::string> preprocess_argv = {compiler, "-E"};
+    preprocess_argv.insert(preprocess_argv.end(), invocation.preprocess_args.begin(), invocation.preprocess_args.end());
+    preprocess_argv.push_back("-o");
+    preprocess_argv.push_back(preprocessed_path);
+    if (run(preprocess_argv, nullptr, false) != 0) {
+        fs::remove(preprocessed_path, ec);
+        return exec_compiler(compile_argv);
+    }
+
+    std::ifstream preprocessed_file(preprocessed_path, std::ios::binary);
+    std::string preprocessed((std::istreambuf_iterator<char>(preprocessed_file)), std::istreambuf_iterator<char>());
+    preprocessed_file.close();
+    fs::remove(preprocessed_path, ec);
+
+    std::string key;
+    std::string diagnostics;
+    if (cache) {
+        // 编译器身份取路径、大小和修改时间，编译器升级后旧条目不再命中
+        const char* basedir_env = std::getenv("LISA_CACHE_BASEDIR");
+        std::string basedir = basedir_env != nullptr ? basedir_env : "";
+        struct stat compiler_stat;
+        if (stat(compiler.c_str(), &compiler_stat) != 0) {
+            return exec_compiler(compile_argv);
+        }
+
+        std::string identity = std::string(kHashVersion) + "\n" + fs::canonical(compiler, ec).string() + "\n" +
+                               std::to_string(compiler_stat.st_size) + "\n" +
+                               std::to_string(compiler_stat.st_mtime) + "\n";
+        for (const auto& arg : invocation.hashed_args) {
+            identity += rewrite_basedir(arg, basedir) + "\n";
+        }
+        key = CompilerCache::hash(identity + rewrite_basedir(preprocessed, basedir));
+
+        if (cache->fetch(key, invocation.output, diagnostics)) {
+            ssize_t ignored = write(STDERR_FILENO, diagnostics.data(), diagnostics.size());
+            (void)ignored;
+            return 0;
+        }
+    }
+
+    // 节点不可用或远程编译失败时在本机编译，错误信息以本机编译为准
+    if (peer) {
+        auto result = compile_remote(*peer, compiler, compiler_name, invocation, std::move(preprocessed));
+        if (result && write_object(invocation.output, result->object)) {
+            ssize_t ignored = write(STDERR_FILENO, result->diagnostics.data(), result->diagnostics.size());
+            (void)ignored;
+            if (cache) {
+                cache->store(key, invocation.output, result->diagnostics);
+            }
+            return 0;
+        }
+    }
+
+    int exit_code = run(compile_argv, &diagnostics, true);
+    if (exit_code == 0 && cache) {
+        cache->store(key, invocation.output, diagnostics);
+    }
+    return exit_code;
+}
@@ -3,10 +3,39 @@
 #include <yaml-cpp/yaml.h>
 #include <filesystem>
 #include <stdexcept>
+#include <thread>
 
 namespace fs = std::filesystem;
 using namespace lisa::server;
 
+namespace {
+
+// 将YAML节点递归转换为JSON
+nlohmann::json yaml_to_json(const YAML::Node& node) {
+    switch (node.Type()) {
+        case YAML::NodeType::Map: {
+            nlohmann::json object = nlohmann::json::object();
+            for (const auto& item : node) {
+                object[item.first.as<std::string>()] = yaml_to_json(item.second);
+            }
+            return object;
+        }
+        case YAML::NodeType::Sequence: {
+            nlohmann::json array = nlohmann::json::array();
+            for (const auto& item : node) {
+                array.push_back(yaml_to_json(item));
+            }
+            return array;
+        }
+        case YAML::NodeType::Scalar:
+            return node.as<std::string>();
+        default:
+            return nullptr;
+    }
+}
+
+} // namespace
+
 bool Config::load(const std::string& file_path) {
     try {
         if (!fs::exists(file_path)) {
@@ -16,7 +45,7 @@ bool Config::load(const std::string& file_path) {
 
         // 加载并解析YAML配置文件
         YAML::Node config = YAML::LoadFile(file_path);
-        config_json_ = nlohmann::json::parse(config.as<std::string>());
+        config_json_ = yaml_to_json(config);
 
         // 服务器配置
         if (config["server"]) {
@@ -36,6 +65,59 @@ bool Config::load(const std::string& file_path) {
             if (config["git"]["cache_expiration_seconds"]) {
                 repo_cache_expiration_seconds_ = config["git"]["cache_expiration_seconds"].as<time_t>();
             }
+            if (config["git"]["max_concurrent_fetches"]) {
+                max_concurrent_fetches_ = config["git"]["max_concurrent_fetches"].as<size_t>();
+            }
+            if (config["git"]["fetch_freshness_seconds"]) {
+                fetch_freshness_seconds_ = config["git"]["fetch_freshness_seconds"].as<time_t>();
+            }
+            if (config["git"]["clone_depth"]) {
+                clone_depth_ = config["git"]["clone_depth"].as<int>();
+            }
+            if (config["git"]["clone_filter"]) {
+                clone_filter_ = config["git"]["clone_filter"].as<std::string>();
+            }
+        }
+
+        // 预取配置
+        if (config["prefetch"]) {
+            if (config["prefetch"]["interval_seconds"]) {
+                prefetch_interval_seconds_ = config["prefetch"]["interval_seconds"].as<time_t>();
+            }
+            if (config["prefetch"]["top_k"]) {
+                prefetch_top_k_ = config["prefetch"]["top_k"].as<size_t>();
+            }
+            if (config["prefetch"]["max_concurrent"]) {
+                prefetch_max_concurrent_ = config["prefetch"]["max_concurrent"].as<size_t>();
+            }
+            if (config["prefetch"]["max_idle_seconds"]) {
+                prefetch_max_idle_seconds_ = config["prefetch"]["max_idle_seconds"].as<time_t>();
+            }
+        }
+
+        // 缓存配置
+        if (config["cache"]) {
+            if (config["cache"]["repo_quota_bytes"]) {
+                repo_cache_quota_bytes_ = config["cache"]["repo_quota_bytes"].as<uint64_t>();
+            }
+            if (config["cache"]["build_quota_bytes"]) {
+                build_cache_quota_bytes_ = config["cache"]["build_quota_bytes"].as<uint64_t>();
+            }
+            if (config["cache"]["result_cache_path"]) {
+                result_cache_path_ = config["cache"]["result_cache_path"].as<std::string>();
+            }
+            if (config["cache"]["result_quota_bytes"]) {
+                result_cache_quota_bytes_ = config["cache"]["result_quota_bytes"].as<uint64_t>();
+            }
+            if (config["cache"]["compiler_cache_path"]) {
+                compiler_cache_path_ = config["cache"]["compiler_cache_path"].as<std::string>();
+            }
+            if (config["cache"]["compiler_quota_bytes"]) {
+                compiler_cache_quota_bytes_ = config["cache"]["compiler_quota_bytes"].as<uint64_t>();
+            }
+            if (config["cache"]["janitor_interval_seconds"]) {
+                janitor_interval_seconds_ = config["cache"]["janitor_interval_seconds"].as<time_t>();
+            }
         }
 
         // 编译配置
@@ -46,11 +128,102 @@ bool Config::load(const std::string& file_path) {
             if (config["compilation"]["max_concurrent_jobs"]) {
                 max_concurrent_jobs_ = config["compilation"]["max_concurrent_jobs"].as<size_t>();
             }
+            if (config["compilation"]["core_budget"]) {
+                core_budget_ = config["compilation"]["core_budget"].as<size_t>();
+            }
+            if (config["compilation"]["max_warm_dirs"]) {
+                max_warm_dirs_ = config["compilation"]["max_warm_dirs"].as<size_t>();
+            }
+            if (config["compilation"]["compiler_cache"]) {
+                compiler_cache_enabled_ = config["compilation"]["compiler_cache"].as<bool>();
+            }
+            if (config["compilation"]["compiler_wrapper"]) {
+                compiler_wrapper_ = config["compilation"]["compiler_wrapper"].as<std::string>();
+            }
+            if (config["compilation"]["journal_path"]) {
+                journal_path_ = config["compilation"]["journal_path"].as<std::string>();
+            }
+            if (config["compilation"]["output_head_bytes"]) {
+                output_head_bytes_ = config["compilation"]["output_head_bytes"].as<size_t>();
+            }
+            if (config["compilation"]["output_tail_bytes"]) {
+                output_tail_bytes_ = config["compilation"]["output_tail_bytes"].as<size_t>();
+            }
             if (config["compilation"]["job_expiration_seconds"]) {
                 job_expiration_seconds_ = config["compilation"]["job_expiration_seconds"].as<time_t>();
             }
         }
 
+        // 调度配置
+        if (config["scheduling"]) {
+            if (config["scheduling"]["tenant_weights"]) {
+                for (const auto& item : config["scheduling"]["tenant_weights"]) {
+                    tenant_weights_[item.first.as<std::string>()] = item.second.as<double>();
+                }
+            }
+            if (config["scheduling"]["policy"]) {
+                std::string policy = config["scheduling"]["policy"].as<std::string>();
+                if (policy != "fair_share" && policy != "shortest_first") {
+                    throw std::invalid_argument("Unknown scheduling policy: " + policy);
+                }
+                shortest_job_first_ = policy == "shortest_first";
+            }
+            if (config["scheduling"]["aging_factor"]) {
+                aging_factor_ = config["scheduling"]["aging_factor"].as<double>();
+            }
+        }
+
+        // 资源上限配置，租户上限中未指定的项取默认上限
+        if (config["limits"]) {
+            auto read_limits = [](const YAML::Node& node, ResourceLimits limits) {
+                if (node["cpus"]) {
+                    limits.cpus = node["cpus"].as<double>();
+                }
+                if (node["memory_bytes"]) {
+                    limits.memory_bytes = node["memory_bytes"].as<uint64_t>();
+                }
+                if (node["pids"]) {
+                    limits.pids = node["pids"].as<uint64_t>();
+                }
+                return limits;
+            };
+            if (config["limits"]["cgroups"]) {
+                cgroups_enabled_ = config["limits"]["cgroups"].as<bool>();
+            }
+            if (config["limits"]["cgroup_root"]) {
+                cgroup_root_ = config["limits"]["cgroup_root"].as<std::string>();
+            }
+            default_limits_ = read_limits(config["limits"], default_limits_);
+            if (config["limits"]["tenants"]) {
+                for (const auto& item : config["limits"]["tenants"]) {
+                    tenant_limits_[item.first.as<std::string>()] = read_limits(item.second, default_limits_);
+                }
+            }
+        }
+
+        // 集群配置
+        cluster_max_units_ = std::thread::hardware_concurrency();
+        if (config["cluster"]) {
+            if (config["cluster"]["self"]) {
+                cluster_self_ = config["cluster"]["self"].as<std::string>();
+            }
+            if (config["cluster"]["virtual_nodes"]) {
+                cluster_virtual_nodes_ = config["cluster"]["virtual_nodes"].as<size_t>();
+            }
+            if (config["cluster"]["probe_interval_seconds"]) {
+                cluster_probe_interval_seconds_ = config["cluster"]["probe_interval_seconds"].as<time_t>();
+            }
+            if (config["cluster"]["peers"]) {
+                cluster_peers_ = config["cluster"]["peers"].as<std::vector<std::string>>();
+            }
+            if (config["cluster"]["compilers"]) {
+                cluster_compilers_ = config["cluster"]["compilers"].as<std::vector<std::string>>();
+            }
+            if (config["cluster"]["max_units"]) {
+                cluster_max_units_ = config["cluster"]["max_units"].as<size_t>();
+            }
+        }
+
         // 验证配置有效性
         return validate();
     } catch (const YAML::Exception& e) {
@@ -74,6 +247,77 @@ bool Config::validate() {
             throw std::invalid_argument("Max concurrent jobs must be greater than 0");
         }
 
+        // 验证最大并发获取数
+        if (max_concurrent_fetches_ == 0) {
+            throw std::invalid_argument("Max concurrent fetches must be greater than 0");
+        }
+
+        // 验证新鲜度窗口
+        if (fetch_freshness_seconds_ < 0) {
+            throw std::invalid_argument("Fetch freshness window must not be negative");
+        }
+
+        // 验证预取配置
+        if (prefetch_interval_seconds_ < 0) {
+            throw std::invalid_argument("Prefetch interval must not be negative");
+        }
+
+        // 验证缓存清理周期
+        if (janitor_interval_seconds_ < 0) {
+            throw std::invalid_argument("Janitor interval must not be negative");
+        }
+
+        // 验证租户权重
+        for (const auto& item : tenant_weights_) {
+            if (item.second <= 0) {
+                throw std::invalid_argument("Tenant weight must be positive: " + item.first);
+            }
+        }
+
+        // 验证排队折减系数
+        if (aging_factor_ < 0) {
+            throw std::invalid_argument("Aging factor must not be negative");
+        }
+
+        // 验证资源上限
+        if (default_limits_.cpus < 0) {
+            throw std::invalid_argument("CPU limit must not be negative");
+        }
+        for (const auto& item : tenant_limits_) {
+            if (item.second.cpus < 0) {
+                throw std::invalid_argument("CPU limit must not be negative: " + item.first);
+            }
+        }
+
+        // 验证集群节点地址
+        std::vector<std::string> cluster_nodes = cluster_peers_;
+        if (!cluster_self_.empty()) {
+            cluster_nodes.push_back(cluster_self_);
+        }
+        for (const auto& node : cluster_nodes) {
+            size_t colon = node.rfind(':');
+            if (colon == std::string::npos || colon == 0 || colon + 1 == node.size() ||
+                node.find_first_not_of("0123456789", colon + 1) != std::string::npos) {
+                throw std::invalid_argument("Cluster node must be host:port: " + node);
+            }
+        }
+        if (cluster_virtual_nodes_ == 0) {
+            throw std::invalid_argument("Cluster virtual nodes must be positive");
+        }
+        if (cluster_probe_interval_seconds_ < 0) {
+            throw std::invalid_argument("Cluster probe interval must not be negative");
+        }
+        for (const auto& compiler : cluster_compilers_) {
+            if (compiler.empty() || compiler.find('/') != std::string::npos) {
+                throw std::invalid_argument("Cluster compiler must be a program name: " + compiler);
+            }
+        }
+
+        // 验证克隆选项
+        if (clone_depth_ < 0) {
+            throw std::invalid_argument("Clone depth must not be negative: " + std::to_string(clone_depth_));
+        }
+
         // 验证路径 - 如果不存在则创建
         if (!fs::exists(git_repo_path_)) {
             Logger::info("Creating git repo directory: " + git_repo_path_);
@@ -2,7 +2,10 @@
 #define CONFIG_H
 
 #include <string>
+#include <vector>
+#include <unordered_map>
 #include <nlohmann/json.hpp>
+#include "cgroup_manager.h"
 #include "logger.h"
 
 namespace lisa::server {
@@ -30,12 +33,117 @@ public:
     // 获取最大并发编译任务数
     size_t max_concurrent_jobs() const { return max_concurrent_jobs_; }
 
+    // 获取构建可用的CPU核心数，0 表示全部
+    size_t core_budget() const { return core_budget_; }
+
+    // 获取热构建目录数量上限，0 表示禁用增量构建
+    size_t max_warm_dirs() const { return max_warm_dirs_; }
+
+    // 是否通过编译器包装程序使用编译器输出缓存
+    bool compiler_cache_enabled() const { return compiler_cache_enabled_; }
+
+    // 获取编译器包装程序路径，为空时使用服务器程序所在目录下的 lisa_cc
+    const std::string& compiler_wrapper() const { return compiler_wrapper_; }
+
+    // 获取任务日志目录，为空表示不持久化任务
+    const std::string& journal_path() const { return journal_path_; }
+
+    // 获取保留的构建输出开头字节数
+    size_t output_head_bytes() const { return output_head_bytes_; }
+
+    // 获取保留的构建输出结尾字节数
+    size_t output_tail_bytes() const { return output_tail_bytes_; }
+
     // 获取任务过期时间(秒)
     time_t job_expiration_seconds() const { return job_expiration_seconds_; }
 
     // 获取仓库缓存过期时间(秒)
     time_t repo_cache_expiration_seconds() const { return repo_cache_expiration_seconds_; }
 
+    // 获取最大并发代码获取数
+    size_t max_concurrent_fetches() const { return max_concurrent_fetches_; }
+
+    // 获取分支获取结果的复用窗口(秒)
+    time_t fetch_freshness_seconds() const { return fetch_freshness_seconds_; }
+
+    // 获取默认浅克隆深度（0 表示完整历史）
+    int clone_depth() const { return clone_depth_; }
+
+    // 获取默认部分克隆过滤器（为空表示不过滤）
+    const std::string& clone_filter() const { return clone_filter_; }
+
+    // 获取后台预取周期(秒)，0 表示禁用
+    time_t prefetch_interval_seconds() const { return prefetch_interval_seconds_; }
+
+    // 获取每轮预取的仓库数
+    size_t prefetch_top_k() const { return prefetch_top_k_; }
+
+    // 获取最大并发后台预取数
+    size_t prefetch_max_concurrent() const { return prefetch_max_concurrent_; }
+
+    // 获取预取的最大空闲时间(秒)，空闲更久的仓库不再预取
+    time_t prefetch_max_idle_seconds() const { return prefetch_max_idle_seconds_; }
+
+    // 获取仓库缓存字节配额，0 表示不限制
+    uint64_t repo_cache_quota_bytes() const { return repo_cache_quota_bytes_; }
+
+    // 获取构建目录字节配额，0 表示不限制
+    uint64_t build_cache_quota_bytes() const { return build_cache_quota_bytes_; }
+
+    // 获取构建结果缓存路径
+    const std::string& result_cache_path() const { return result_cache_path_; }
+
+    // 获取构建结果缓存字节配额，0 表示不限制
+    uint64_t result_cache_quota_bytes() const { return result_cache_quota_bytes_; }
+
+    // 获取编译器输出缓存路径
+    const std::string& compiler_cache_path() const { return compiler_cache_path_; }
+
+    // 获取编译器输出缓存字节配额，0 表示不限制
+    uint64_t compiler_cache_quota_bytes() const { return compiler_cache_quota_bytes_; }
+
+    // 获取租户调度权重，未列出的租户为 1
+    const std::unordered_map<std::string, double>& tenant_weights() const { return tenant_weights_; }
+
+    // 是否在租户子队列内按预计耗时最短优先调度
+    bool shortest_job_first() const { return shortest_job_first_; }
+
+    // 获取排队时间对预计耗时的折减系数
+    double aging_factor() const { return aging_factor_; }
+
+    // 获取本节点在集群中的地址（host:port），为空表示不按仓库路由
+    const std::string& cluster_self() const { return cluster_self_; }
+
+    // 获取每个节点在一致性哈希环上的虚拟节点数
+    size_t cluster_virtual_nodes() const { return cluster_virtual_nodes_; }
+
+    // 获取集群节点健康探测周期(秒)
+    time_t cluster_probe_interval_seconds() const { return cluster_probe_interval_seconds_; }
+
+    // 获取集群中其他节点的列表（host:port），同时用于分布式编译
+    const std::vector<std::string>& cluster_peers() const { return cluster_peers_; }
+
+    // 获取可以接收和发送编译单元的编译器名称
+    const std::vector<std::string>& cluster_compilers() const { return cluster_compilers_; }
+
+    // 获取同时编译的其他节点发来的编译单元数上限，0 表示不接收
+    size_t cluster_max_units() const { return cluster_max_units_; }
+
+    // 是否让每个构建在独立的 cgroup 中运行并受资源上限约束
+    bool cgroups_enabled() const { return cgroups_enabled_; }
+
+    // 获取委托给服务器的 cgroup 目录，为空时使用服务器进程所在的 cgroup
+    const std::string& cgroup_root() const { return cgroup_root_; }
+
+    // 获取构建的默认资源上限
+    const ResourceLimits& default_limits() const { return default_limits_; }
+
+    // 获取租户的资源上限，未列出的租户使用默认上限
+    const std::unordered_map<std::string, ResourceLimits>& tenant_limits() const { return tenant_limits_; }
+
+    // 获取缓存清理周期(秒)，0 表示禁用
+    time_t janitor_interval_seconds() const { return janitor_interval_seconds_; }
+
     // 获取配置的JSON对象
     const nlohmann::json& get_json() const { return config_json_; }
 
@@ -45,8 +153,43 @@ private:
     std::string git_repo_path_ = "./repos"; // Git仓库存储路径
     std::string build_root_path_ = "./builds"; // 构建根目录
     size_t max_concurrent_jobs_ = 4;         // 最大并发编译任务数
+    size_t core_budget_ = 0;                 // 构建可用的CPU核心数
+    size_t max_warm_dirs_ = 4;               // 热构建目录数量上限
+    bool compiler_cache_enabled_ = true;     // 使用编译器输出缓存
+    std::string compiler_wrapper_;           // 编译器包装程序路径
+    std::string journal_path_ = "./journal"; // 任务日志目录
+    size_t output_head_bytes_ = 256 * 1024;  // 保留的构建输出开头字节数
+    size_t output_tail_bytes_ = 768 * 1024;  // 保留的构建输出结尾字节数
     time_t job_expiration_seconds_ = 3600;   // 任务过期时间(秒)
     time_t repo_cache_expiration_seconds_ = 86400; // 仓库缓存过期时间(秒)
+    size_t max_concurrent_fetches_ = 4;      // 最大并发代码获取数
+    time_t fetch_freshness_seconds_ = 10;    // 分支获取结果的复用窗口(秒)
+    int clone_depth_ = 0;                    // 默认浅克隆深度
+    std::string clone_filter_;               // 默认部分克隆过滤器
+    time_t prefetch_interval_seconds_ = 60;  // 后台预取周期(秒)
+    size_t prefetch_top_k_ = 8;              // 每轮预取的仓库数
+    size_t prefetch_max_concurrent_ = 2;     // 最大并发后台预取数
+    time_t prefetch_max_idle_seconds_ = 3600; // 预取的最大空闲时间(秒)
+    uint64_t repo_cache_quota_bytes_ = 0;    // 仓库缓存字节配额
+    uint64_t build_cache_quota_bytes_ = 0;   // 构建目录字节配额
+    std::string result_cache_path_ = "./result-cache"; // 构建结果缓存路径
+    uint64_t result_cache_quota_bytes_ = 0;  // 构建结果缓存字节配额
+    std::string compiler_cache_path_ = "./compiler-cache"; // 编译器输出缓存路径
+    uint64_t compiler_cache_quota_bytes_ = 0; // 编译器输出缓存字节配额
+    time_t janitor_interval_seconds_ = 60;   // 缓存清理周期(秒)
+    std::unordered_map<std::string, double> tenant_weights_; // 租户调度权重
+    bool shortest_job_first_ = false;        // 预计耗时最短优先调度
+    double aging_factor_ = 1.0;              // 排队时间折减系数
+    std::string cluster_self_;               // 本节点的集群地址
+    size_t cluster_virtual_nodes_ = 64;      // 每个节点的虚拟节点数
+    time_t cluster_probe_interval_seconds_ = 5; // 节点健康探测周期(秒)
+    std::vector<std::string> cluster_peers_;  // 集群中的其他节点
+    std::vector<std::string> cluster_compilers_ = {"cc", "c++", "gcc", "g++", "clang", "clang++"}; // 编译单元允许的编译器
+    size_t cluster_max_units_ = 0;           // 同时编译的编译单元数上限，load 时默认取CPU核心数
+    bool cgroups_enabled_ = false;           // 构建在独立的 cgroup 中运行
+    std::string cgroup_root_;                // 委托给服务器的 cgroup 目录
+    ResourceLimits default_limits_;          // 构建的默认资源上限
+    std::unordered_map<std::string, ResourceLimits> tenant_limits_; // 租户的资源上限
     nlohmann::json config_json_;             // 完整配置JSON对象
 
     // 验证配置有效性
@@ -0,0 +1,197 @@
+#include "core_scheduler.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <sched.h>
+
+namespace fs = std::filesystem;
+using namespace lisa::server;
+
+CoreScheduler::CoreScheduler(size_t core_budget, size_t max_concurrent_jobs) {
+    // 只在服务器进程自身允许的CPU范围内分配，兼容taskset和容器的cpuset限制
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus_.push_back(cpu);
+            }
+        }
+    }
+    if (cpus_.empty()) {
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+            cpus_.push_back(static_cast<int>(cpu));
+        }
+    }
+    if (core_budget > 0 && core_budget < cpus_.size()) {
+        cpus_.resize(core_budget);
+    }
+
+    for (int cpu : cpus_) {
+        load_[cpu] = 0;
+    }
+    fair_share_ = std::max<size_t>(1, cpus_.size() / std::max<size_t>(1, max_concurrent_jobs));
+
+    Logger::info("Core scheduler budget: " + std::to_string(cpus_.size()) + " cores, fair share " +
+                 std::to_string(fair_share_));
+}
+
+std::vector<int> CoreScheduler::acquire(const std::string& job_id, size_t pending_jobs) {
+    std::vector<std::pair<pid_t, std::vector<int>>> rebinds;
+    std::vector<int> cpus;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        size_t free = std::count_if(load_.begin(), load_.end(), [](const auto& entry) { return entry.second == 0; });
+        size_t want = pending_jobs == 0 ? std::max(free, fair_share_) : fair_share_;
+
+        // 队列为空时扩张出去的核心，在新任务到来时收回到公平份额
+        for (auto& entry : grants_) {
+            Grant& grant = entry.second;
+            bool shrunk = false;
+            while (free < want && grant.cpus.size() > fair_share_) {
+                int cpu = grant.cpus.back();
+                grant.cpus.pop_back();
+                if (--load_[cpu] == 0) {
+                    ++free;
+                }
+                shrunk = true;
+            }
+            if (shrunk && grant.process_group > 0) {
+                rebinds.emplace_back(grant.process_group, grant.cpus);
+            }
+        }
+
+        cpus = take_free(std::min(want, free));
+        if (cpus.empty()) {
+            // 预算小于并发任务数，所有核心都已分出，与负载最低的核心共享
+            auto least = std::min_element(load_.begin(), load_.end(),
+                                          [](const auto& a, const auto& b) { return a.second < b.second; });
+            ++least->second;
+            cpus.push_back(least->first);
+        }
+        grants_[job_id] = {cpus, 0};
+    }
+
+    for (const auto& rebind : rebinds) {
+        apply_affinity(rebind.first, rebind.second);
+    }
+    return cpus;
+}
+
+void CoreScheduler::attach(const std::string& job_id, pid_t process_group) {
+    std::vector<int> cpus;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = grants_.find(job_id);
+        if (it == grants_.end()) {
+            return;
+        }
+        it->second.process_group = process_group;
+        cpus = it->second.cpus;
+    }
+
+    // 分配后到启动前之间可能已被收回部分核心，以当前集合为准重新绑定
+    apply_affinity(process_group, cpus);
+}
+
+void CoreScheduler::release(const std::string& job_id, size_t pending_jobs) {
+    std::vector<std::pair<pid_t, std::vector<int>>> rebinds;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = grants_.find(job_id);
+        if (it == grants_.end()) {
+            return;
+        }
+        for (int cpu : it->second.cpus) {
+            --load_[cpu];
+        }
+        grants_.erase(it);
+
+        if (pending_jobs > 0) {
+            return;
+        }
+
+        // 没有排队任务时把空闲核心轮流分给运行中的任务。构建的 -j 在启动时已经确定，
+        // 扩张只放宽CPU亲和性，让链接、测试等自带多线程的步骤用上空闲核心
+        std::vector<Grant*> running;
+        for (auto& entry : grants_) {
+            if (entry.second.process_group > 0) {
+                running.push_back(&entry.second);
+            }
+        }
+        if (running.empty()) {
+            return;
+        }
+
+        std::vector<int> free = take_free(cpus_.size());
+        for (size_t i = 0; i < free.size(); ++i) {
+            running[i % running.size()]->cpus.push_back(free[i]);
+        }
+        if (!free.empty()) {
+            for (Grant* grant : running) {
+                rebinds.emplace_back(grant->process_group, grant->cpus);
+            }
+        }
+    }
+
+    for (const auto& rebind : rebinds) {
+        apply_affinity(rebind.first, rebind.second);
+    }
+}
+
+std::vector<int> CoreScheduler::take_free(size_t count) {
+    std::vector<int> cpus;
+    for (auto& entry : load_) {
+        if (cpus.size() >= count) {
+            break;
+        }
+        if (entry.second == 0) {
+            entry.second = 1;
+            cpus.push_back(entry.first);
+        }
+    }
+    return cpus;
+}
+
+void CoreScheduler::apply_affinity(pid_t process_group, const std::vector<int>& cpus) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &cpu_set);
+    }
+
+    // 亲和性是线程属性，需要逐个设置进程组内每个进程的每个线程；新派生的进程会继承父进程的设置
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator("/proc", ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.empty() || !std::all_of(name.begin(), name.end(), ::isdigit)) {
+            continue;
+        }
+
+        // /proc/<pid>/stat 中命令名可能含空格，从最后一个 ')' 之后解析：状态 父进程 进程组
+        std::ifstream stat_file(entry.path() / "stat");
+        std::string stat;
+        std::getline(stat_file, stat);
+        size_t end = stat.rfind(')');
+        if (end == std::string::npos) {
+            continue;
+        }
+        std::istringstream fields(stat.substr(end + 1));
+        char state;
+        pid_t parent;
+        pid_t group = 0;
+        fields >> state >> parent >> group;
+        if (group != process_group) {
+            continue;
+        }
+
+        std::error_code task_ec;
+        for (const auto& task : fs::directory_iterator(entry.path() / "task", task_ec)) {
+            pid_t tid = static_cast<pid_t>(std::stol(task.path().filename().string()));
+            sched_setaffinity(tid, sizeof(cpu_set), &cpu_set);
+        }
+    }
+}
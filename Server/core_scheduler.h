@@ -0,0 +1,60 @@
+#ifndef CORE_SCHEDULER_H
+#define CORE_SCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <sys/types.h>
+#include "logger.h"
+
+namespace lisa::server {
+
+// CPU核心调度器：持有全局核心预算，为每个构建分配互不重叠的CPU集合，
+// 构建的并行度与分到的核心数一致，避免多个 make -jN 同时运行导致超额订阅
+class CoreScheduler {
+public:
+    // core_budget 为 0 时使用服务器进程可用的全部CPU
+    CoreScheduler(size_t core_budget, size_t max_concurrent_jobs);
+
+    // 禁止拷贝构造和赋值
+    CoreScheduler(const CoreScheduler&) = delete;
+    CoreScheduler& operator=(const CoreScheduler&) = delete;
+
+    // 为任务分配CPU集合。没有排队任务时拿走全部空闲核心，否则按公平份额分配；
+    // 空闲核心不足时收回超出公平份额的任务多占的核心
+    std::vector<int> acquire(const std::string& job_id, size_t pending_jobs);
+
+    // 登记任务的进程组，之后调整其CPU集合时整组重新绑定
+    void attach(const std::string& job_id, pid_t process_group);
+
+    // 释放任务的CPU；没有排队任务时把空出的核心分给仍在运行的任务
+    void release(const std::string& job_id, size_t pending_jobs);
+
+    // 核心预算
+    size_t budget() const { return cpus_.size(); }
+
+private:
+    // 任务持有的核心
+    struct Grant {
+        std::vector<int> cpus;
+        pid_t process_group = 0;
+    };
+
+    std::vector<int> cpus_;                          // 预算内的CPU编号，升序
+    std::map<int, size_t> load_;                     // CPU编号 -> 持有该核心的任务数
+    std::unordered_map<std::string, Grant> grants_;  // 任务ID -> 持有的核心
+    size_t fair_share_;
+    std::mutex mutex_;
+
+    // 按编号顺序取出空闲核心，相邻核心通常共享缓存
+    std::vector<int> take_free(size_t count);
+
+    // 将进程组中所有进程的所有线程重新绑定到新的CPU集合
+    static void apply_affinity(pid_t process_group, const std::vector<int>& cpus);
+};
+
+} // namespace lisa::server
+
+#endif // CORE_SCHEDULER_H
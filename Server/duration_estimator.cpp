@@ -0,0 +1,67 @@
+#include "duration_estimator.h"
+#include <algorithm>
+#include <vector>
+#include <chrono>
+
+using namespace lisa::server;
+
+namespace {
+
+// 滑动平均中新样本的权重
+constexpr double kSmoothing = 0.3;
+
+} // namespace
+
+std::string DurationEstimator::make_key(const std::string& repo_url, const std::string& command) {
+    return repo_url + "\n" + command;
+}
+
+void DurationEstimator::record(const std::string& key, double seconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+
+    if (histories_.size() >= kMaxKeys && histories_.count(key) == 0) {
+        auto oldest = std::min_element(histories_.begin(), histories_.end(), [](const auto& a, const auto& b) {
+            return a.second.updated_at < b.second.updated_at;
+        });
+        histories_.erase(oldest);
+    }
+
+    History& history = histories_[key];
+    history.samples.push_back(seconds);
+    if (history.samples.size() > kMaxSamples) {
+        history.samples.pop_front();
+    }
+    history.updated_at = now;
+
+    overall_ewma_ = overall_ewma_ == 0 ? seconds : (1 - kSmoothing) * overall_ewma_ + kSmoothing * seconds;
+}
+
+std::optional<DurationEstimate> DurationEstimator::estimate(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = histories_.find(key);
+    if (it == histories_.end()) {
+        return std::nullopt;
+    }
+
+    const History& history = it->second;
+    return DurationEstimate{percentile(history.samples, 0.5), percentile(history.samples, 0.9), history.samples.size()};
+}
+
+double DurationEstimator::expected_seconds(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = histories_.find(key);
+    if (it == histories_.end()) {
+        return overall_ewma_;
+    }
+
+    // 中位数不受偶发的超长构建（如清空缓存后的首次构建）影响
+    return percentile(it->second.samples, 0.5);
+}
+
+double DurationEstimator::percentile(const std::deque<double>& samples, double fraction) {
+    std::vector<double> sorted(samples.begin(), samples.end());
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
@@ -0,0 +1,64 @@
+#ifndef DURATION_ESTIMATOR_H
+#define DURATION_ESTIMATOR_H
+
+#include <string>
+#include <deque>
+#include <optional>
+#include <unordered_map>
+#include <mutex>
+#include <ctime>
+
+namespace lisa::server {
+
+// 构建耗时估计
+struct DurationEstimate {
+    double p50_seconds;
+    double p90_seconds;   // 较保守的估计，用于给出完成时间的上限
+    size_t samples;
+};
+
+// 构建耗时估计器：按 (仓库, 构建命令) 记录最近样本的分位数，另维护所有构建的指数滑动平均作为无历史时的估计
+class DurationEstimator {
+public:
+    DurationEstimator() = default;
+
+    // 禁止拷贝构造和赋值
+    DurationEstimator(const DurationEstimator&) = delete;
+    DurationEstimator& operator=(const DurationEstimator&) = delete;
+
+    // 计算历史记录的键
+    static std::string make_key(const std::string& repo_url, const std::string& command);
+
+    // 记录一次构建耗时
+    void record(const std::string& key, double seconds);
+
+    // 获取耗时估计，没有历史记录时返回空
+    std::optional<DurationEstimate> estimate(const std::string& key) const;
+
+    // 预计耗时：有历史时取中位数，否则取所有构建的平均值，仍没有数据时为0
+    double expected_seconds(const std::string& key) const;
+
+private:
+    // 每个键保留的最近样本数，用于计算分位数
+    static constexpr size_t kMaxSamples = 64;
+
+    // 最多跟踪的键数，超出时丢弃最久未更新的记录
+    static constexpr size_t kMaxKeys = 4096;
+
+    // 单个键的历史
+    struct History {
+        std::deque<double> samples;
+        time_t updated_at = 0;
+    };
+
+    std::unordered_map<std::string, History> histories_;
+    double overall_ewma_ = 0;
+    mutable std::mutex mutex_;
+
+    // 计算样本的分位数，样本不能为空
+    static double percentile(const std::deque<double>& samples, double fraction);
+};
+
+} // namespace lisa::server
+
+#endif // DURATION_ESTIMATOR_H
@@ -0,0 +1,190 @@
+#include "fetch_pipeline.h"
+#include <stdexcept>
+#include <filesystem>
+#include "workspace.h"
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+using namespace lisa::server;
+
+namespace {
+
+// 构建是否可能被中途终止：取消、被信号杀死(shell 以 128+N 报告)或有进程因内存不足被杀
+bool build_interrupted(const CompilationJob& job) {
+    return job.status == CompilationStatus::CANCELLED || job.exit_code > 128 ||
+           (job.usage && job.usage->oom_kills > 0);
+}
+
+} // namespace
+
+FetchPipeline::FetchPipeline(GitHandler& git_handler, CompilationHandler& compilation_handler, ResultCache& result_cache,
+                             WarmDirPool& warm_pool, size_t max_concurrent_fetches)
+    : git_handler_(git_handler),
+      compilation_handler_(compilation_handler),
+      result_cache_(result_cache),
+      warm_pool_(warm_pool),
+      stop_workers_(false) {
+    compilation_handler_.add_completion_listener([this](const CompilationJob& job) { on_job_finished(job); });
+
+    // 启动获取线程
+    for (size_t i = 0; i < max_concurrent_fetches; ++i) {
+        worker_threads_.emplace_back(&FetchPipeline::worker_thread, this);
+    }
+}
+
+FetchPipeline::~FetchPipeline() {
+    compilation_handler_.clear_completion_listeners();
+    stop_workers_ = true;
+    queue_condition_.notify_all();
+
+    // 等待所有获取线程结束
+    for (auto& thread : worker_threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+FetchRequest FetchPipeline::make_request(const std::string& job_id, const json& req_data, FetchOptions defaults) {
+    FetchRequest request;
+    request.job_id = job_id;
+    request.repo_url = req_data.at("repo_url").get<std::string>();
+    request.branch = req_data.value("branch", "main");
+    request.commit_hash = req_data.value("commit_hash", "");
+
+    // 获取选项：请求未指定时使用服务器默认值
+    request.options = defaults;
+    request.options.depth = req_data.value("depth", defaults.depth);
+    request.options.filter = req_data.value("filter", defaults.filter);
+
+    // no_cache 强制重新构建，跳过结果缓存查找；incremental 为false时不使用热目录
+    request.use_cache = !req_data.value("no_cache", false);
+    request.incremental = req_data.value("incremental", true);
+    return request;
+}
+
+void FetchPipeline::submit(FetchRequest request) {
+    request.submitted_at_us = JobTrace::now();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        fetch_queue_.push(std::move(request));
+    }
+    queue_condition_.notify_one();
+}
+
+void FetchPipeline::worker_thread() {
+    while (!stop_workers_) {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        queue_condition_.wait(lock, [this] { return !fetch_queue_.empty() || stop_workers_; });
+
+        if (stop_workers_) break;
+
+        FetchRequest request = std::move(fetch_queue_.front());
+        fetch_queue_.pop();
+
+        lock.unlock();
+
+        process(request);
+    }
+}
+
+void FetchPipeline::process(const FetchRequest& request) {
+    std::string repo_path;
+    std::string work_dir;
+    std::string cache_key;
+
+    // 阶段在任务结束前记录，查询结果时已完整
+    int64_t phase_started = JobTrace::now();
+    std::string phase = "fetch";
+    compilation_handler_.record_phase(request.job_id, "fetch_queue", request.submitted_at_us, phase_started);
+    auto end_phase = [&](const std::string& next) {
+        int64_t now = JobTrace::now();
+        if (!phase.empty()) {
+            compilation_handler_.record_phase(request.job_id, phase, phase_started, now);
+        }
+        phase = next;
+        phase_started = now;
+    };
+
+    try {
+        std::string commit_id = git_handler_.fetch_commit(request.repo_url, request.branch, request.commit_hash, request.options);
+        auto config = compilation_handler_.get_job_config(request.job_id);
+        if (!config) {
+            return;
+        }
+
+        // 以源码树和构建配置为键查找结果缓存，命中时不检出也不构建
+        if (request.use_cache) {
+            cache_key = ResultCache::make_key(git_handler_.tree_id(request.repo_url, commit_id), *config);
+            if (auto cached = result_cache_.lookup(cache_key)) {
+                end_phase("");
+                if (!compilation_handler_.complete_cached_job(request.job_id, cached->exit_code, cached->output)) {
+                    Logger::info("Job " + request.job_id + " was cancelled during fetch");
+                }
+                return;
+            }
+        }
+
+        // 优先在热目录中增量构建；热目录被占用时退回全新构建
+        end_phase("checkout");
+        if (request.incremental) {
+            std::string warm_key = WarmDirPool::make_key(request.repo_url, request.branch, *config);
+            if (auto warm_dir = warm_pool_.acquire(warm_key, request.repo_url, commit_id)) {
+                repo_path = *warm_dir;
+                work_dir = *warm_dir;
+                Logger::info("Job " + request.job_id + " builds incrementally in " + work_dir);
+            }
+        }
+
+        // 同一提交共用只读快照，任务工作目录在获取线程中填充，不占用编译线程
+        if (work_dir.empty()) {
+            repo_path = git_handler_.snapshot(request.repo_url, commit_id);
+            PopulateMethod method = populate_workspace(repo_path, compilation_handler_.build_directory(request.job_id));
+            Logger::info("Prepared workspace of job " + request.job_id + " from " + repo_path + " by " +
+                         populate_method_name(method));
+        }
+        end_phase("");
+    } catch (const std::exception& e) {
+        end_phase("");
+        if (!work_dir.empty()) {
+            warm_pool_.release(work_dir, false);
+        }
+        compilation_handler_.fail_job(request.job_id, "Fetch error: " + std::string(e.what()));
+        return;
+    }
+
+    // 获取期间任务被取消，工作目录不再需要；快照可能被其他任务共用，交给缓存清理
+    if (!compilation_handler_.start_job(request.job_id, repo_path, cache_key, work_dir)) {
+        Logger::info("Job " + request.job_id + " was cancelled during fetch");
+        if (!work_dir.empty()) {
+            warm_pool_.release(work_dir, false);
+        } else {
+            std::error_code ec;
+            fs::remove_all(compilation_handler_.build_directory(request.job_id), ec);
+        }
+    }
+}
+
+void FetchPipeline::on_job_finished(const CompilationJob& job) {
+    // 被终止的构建可能留下写了一半的目标文件，其修改时间较新，下次增量构建会当作最新，热目录不再可信
+    if (!job.work_dir.empty()) {
+        warm_pool_.release(job.work_dir, build_interrupted(job));
+    }
+    store_result(job);
+}
+
+void FetchPipeline::store_result(const CompilationJob& job) {
+    // 只缓存成功的构建，失败可能来自环境问题，重试应当真正执行
+    if (job.cache_key.empty() || job.status != CompilationStatus::COMPLETED) {
+        return;
+    }
+
+    // 输出被截断时缓存的就是截断后的内容，与原任务返回的一致
+    CachedResult result;
+    result.exit_code = job.exit_code;
+    result.output = job.output->snapshot();
+    result.commit_id = job.config.value("commit_hash", "");
+    result.created_at = job.completed_at;
+    result_cache_.store(job.cache_key, result);
+}
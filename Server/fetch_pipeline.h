@@ -0,0 +1,74 @@
+#ifndef FETCH_PIPELINE_H
+#define FETCH_PIPELINE_H
+
+#include <string>
+#include <queue>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "git_handler.h"
+#include "compilation_handler.h"
+#include "result_cache.h"
+#include "warm_pool.h"
+#include "logger.h"
+
+namespace lisa::server {
+
+// 代码获取请求
+struct FetchRequest {
+    std::string job_id;
+    std::string repo_url;
+    std::string branch;
+    std::string commit_hash;
+    FetchOptions options;
+    bool use_cache = true;     // 是否查找并写入结果缓存
+    bool incremental = true;   // 是否允许在热目录中增量构建
+    int64_t submitted_at_us = 0;   // 进入获取队列的时间(微秒)，用于阶段记录
+};
+
+// 获取流水线：在独立线程池中克隆/拉取代码，就绪后交给编译队列
+class FetchPipeline {
+public:
+    FetchPipeline(GitHandler& git_handler, CompilationHandler& compilation_handler, ResultCache& result_cache,
+                  WarmDirPool& warm_pool, size_t max_concurrent_fetches = 4);
+    ~FetchPipeline();
+
+    // 禁止拷贝构造和赋值
+    FetchPipeline(const FetchPipeline&) = delete;
+    FetchPipeline& operator=(const FetchPipeline&) = delete;
+
+    // 由提交请求的JSON构造获取请求，未指定的选项取 defaults
+    static FetchRequest make_request(const std::string& job_id, const nlohmann::json& req_data, FetchOptions defaults);
+
+    // 提交获取请求，立即返回
+    void submit(FetchRequest request);
+
+private:
+    GitHandler& git_handler_;
+    CompilationHandler& compilation_handler_;
+    ResultCache& result_cache_;
+    WarmDirPool& warm_pool_;
+    std::queue<FetchRequest> fetch_queue_;
+    std::vector<std::thread> worker_threads_;
+    std::mutex queue_mutex_;
+    std::condition_variable queue_condition_;
+    std::atomic<bool> stop_workers_;
+
+    // 工作线程函数
+    void worker_thread();
+
+    // 执行单个获取请求
+    void process(const FetchRequest& request);
+
+    // 任务结束：归还热目录并缓存结果
+    void on_job_finished(const CompilationJob& job);
+
+    // 将成功的构建结果写入结果缓存
+    void store_result(const CompilationJob& job);
+};
+
+} // namespace lisa::server
+
+#endif // FETCH_PIPELINE_H
@@ -4,19 +4,82 @@
 #include <filesystem>
 #include <chrono>
 #include <cstdlib>
+#include <vector>
+#include <cctype>
+#include <regex>
+#include <algorithm>
 #include <git2/clone.h>
 #include <git2/pull.h>
 #include <git2/checkout.h>
 #include <git2/branch.h>
 #include <git2/errors.h>
+#include "metrics.h"
+
+// libgit2 1.7 起支持浅克隆（git_fetch_options::depth）
+#if LIBGIT2_VER_MAJOR > 1 || (LIBGIT2_VER_MAJOR == 1 && LIBGIT2_VER_MINOR >= 7)
+#define LISA_GIT_SHALLOW_SUPPORTED 1
+#else
+#define LISA_GIT_SHALLOW_SUPPORTED 0
+#endif
 
 namespace fs = std::filesystem;
 using namespace lisa::server;
 
-GitHandler::GitHandler(const std::string& base_repo_path) : base_repo_path_(base_repo_path) {
+namespace {
+
+// libgit2对象的RAII封装，保证抛出异常时也能释放
+using RepoPtr = std::unique_ptr<git_repository, void (*)(git_repository*)>;
+using RemotePtr = std::unique_ptr<git_remote, void (*)(git_remote*)>;
+using ObjectPtr = std::unique_ptr<git_object, void (*)(git_object*)>;
+
+// 克隆和拉取耗时直方图的桶上界(秒)
+const std::vector<double> kGitFetchBuckets = {0.1, 0.5, 1, 2.5, 5, 10, 30, 60, 120, 300, 600};
+
+} // namespace
+
+GitHandler::GitHandler(const std::string& base_repo_path, const FetchOptions& default_fetch_options, time_t fetch_freshness_seconds)
+    : base_repo_path_(base_repo_path),
+      default_fetch_options_(default_fetch_options),
+      fetch_freshness_seconds_(fetch_freshness_seconds),
+      mirror_root_(base_repo_path + "/mirrors"),
+      checkout_root_(base_repo_path + "/checkouts"),
+      checkout_seq_(0),
+      fetch_requests_(0),
+      served_locally_(0),
+      prefetches_(0),
+      prefetch_failures_(0) {
     init_libgit2();
-    // 创建基础仓库目录
-    fs::create_directories(base_repo_path_);
+    validate_fetch_options(default_fetch_options_);
+    if (!LISA_GIT_SHALLOW_SUPPORTED && effective_depth(default_fetch_options_) > 0) {
+        Logger::warn("libgit2 is older than 1.7, shallow fetches are disabled");
+    }
+
+    // 检出目录只属于本进程的任务，启动时清理上次运行的残留
+    fs::remove_all(checkout_root_);
+    fs::create_directories(mirror_root_);
+    fs::create_directories(checkout_root_);
+
+    // 已有镜像视为刚使用过，重启后保留一个完整的过期周期
+    time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    for (const auto& entry : fs::directory_iterator(mirror_root_)) {
+        if (!entry.is_directory()) {
+            continue;
+        }
+
+        RepoUsage& usage = repo_usage_[entry.path().string()];
+        usage.last_used = now;
+
+        // 从镜像的origin恢复远程URL，供后台预取使用
+        git_repository* raw_repo = nullptr;
+        if (git_repository_open_bare(&raw_repo, entry.path().c_str()) == 0) {
+            RepoPtr repo(raw_repo, git_repository_free);
+            git_remote* raw_remote = nullptr;
+            if (git_remote_lookup(&raw_remote, repo.get(), "origin") == 0) {
+                RemotePtr origin(raw_remote, git_remote_free);
+                usage.repo_url = git_remote_url(origin.get());
+            }
+        }
+    }
 }
 
 GitHandler::~GitHandler() {
@@ -32,12 +95,51 @@ void GitHandler::init_libgit2() {
     }
 }
 
+std::mutex& GitHandler::repo_lock(const std::string& repo_path) {
+    return repo_locks_[std::hash<std::string>{}(repo_path) % kRepoLockShards];
+}
+
+void GitHandler::record_use(const std::string& repo_path, const std::string& repo_url, const std::string& branch) {
+    std::lock_guard<std::mutex> lock(last_used_mutex_);
+    RepoUsage& usage = repo_usage_[repo_path];
+    usage.repo_url = repo_url;
+    usage.last_used = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    ++usage.use_count;
+
+    // 分支按最近使用排序，只保留前几个
+    auto it = std::find(usage.branches.begin(), usage.branches.end(), branch);
+    if (it != usage.branches.end()) {
+        usage.branches.erase(it);
+    }
+    usage.branches.insert(usage.branches.begin(), branch);
+    if (usage.branches.size() > kMaxTrackedBranches) {
+        usage.branches.resize(kMaxTrackedBranches);
+    }
+}
+
+std::string GitHandler::repo_key(const std::string& repo_url) {
+    // 取URL最后一段作为可读名称
+    std::string repo_name = repo_url.substr(repo_url.find_last_of("/:") + 1);
+    if (repo_name.size() > 4 && repo_name.compare(repo_name.size() - 4, 4, ".git") == 0) {
+        repo_name.resize(repo_name.size() - 4);
+    }
+    for (auto& c : repo_name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.') {
+            c = '_';
+        }
+    }
+
+    // 追加URL哈希前缀，避免不同远程的同名仓库冲突
+    git_oid oid;
+    git_odb_hash(&oid, repo_url.data(), repo_url.size(), GIT_OBJECT_BLOB);
+    char hex[GIT_OID_HEXSZ + 1];
+    git_oid_tostr(hex, sizeof(hex), &oid);
+
+    return repo_name + "-" + std::string(hex, 12);
+}
+
 std::string GitHandler::generate_repo_path(const std::string& repo_url) {
-    // 从URL生成唯一目录名（简化实现，实际项目中可使用哈希）
-    size_t last_slash = repo_url.find_last_of('/');
-    size_t dot_git = repo_url.find(".git");
-    std::string repo_name = repo_url.substr(last_slash + 1, dot_git - last_slash - 1);
-    return base_repo_path_ + "/" + repo_name;
+    return mirror_root_ + "/" + repo_key(repo_url) + ".git";
 }
 
 void GitHandler::handle_error(int error_code, const std::string& operation) {
@@ -49,136 +151,641 @@ void GitHandler::handle_error(int error_code, const std::string& operation) {
     throw std::runtime_error(error_msg);
 }
 
-std::string GitHandler::clone_repo(const std::string& repo_url, const std::string& branch) {
-    git_repository* repo = nullptr;
-    git_clone_options clone_opts = GIT_CLONE_OPTIONS_INIT;
-    git_checkout_options checkout_opts = GIT_CHECKOUT_OPTIONS_INIT;
+void GitHandler::validate_fetch_options(const FetchOptions& options) {
+    if (options.depth < 0) {
+        throw std::invalid_argument("Fetch depth must not be negative: " + std::to_string(options.depth));
+    }
+
+    static const std::regex filter_pattern(R"(blob:none|blob:limit=\d+[kmg]?|tree:\d+)");
+    if (!options.filter.empty() && !std::regex_match(options.filter, filter_pattern)) {
+        throw std::invalid_argument("Unsupported fetch filter: " + options.filter);
+    }
+}
+
+int GitHandler::effective_depth(const FetchOptions& options) {
+    if (!LISA_GIT_SHALLOW_SUPPORTED) {
+        return 0;
+    }
+    if (options.depth > 0) {
+        return options.depth;
+    }
+    // libgit2不支持按需补取对象的部分克隆，检出时缺失的blob无法再获取；
+    // 构建只需要目标提交的对象，因此过滤模式退化为只获取分支顶端
+    if (!options.filter.empty()) {
+        return 1;
+    }
+    return 0;
+}
 
-    clone_opts.checkout_opts = checkout_opts;
-    clone_opts.checkout_branch = branch.c_str();
+void GitHandler::fetch_branch(git_repository* repo, const std::string& branch, int depth) {
+    git_remote* raw_remote = nullptr;
+    int error = git_remote_lookup(&raw_remote, repo, "origin");
+    RemotePtr origin(raw_remote, git_remote_free);
+    handle_error(error, "Lookup remote origin");
 
+    // 只获取请求的分支，已有对象不会重复下载
+    std::string refspec = "+refs/heads/" + branch + ":refs/remotes/origin/" + branch;
+    char* refspec_ptr = refspec.data();
+    git_strarray refspecs = {&refspec_ptr, 1};
+
+    git_fetch_options fetch_opts = GIT_FETCH_OPTIONS_INIT;
+#if LISA_GIT_SHALLOW_SUPPORTED
+    fetch_opts.depth = depth;
+#else
+    (void)depth;
+#endif
+    error = git_remote_fetch(origin.get(), &refspecs, &fetch_opts, nullptr);
+    handle_error(error, "Fetch from remote");
+}
+
+std::string GitHandler::clone_repo(const std::string& repo_url, const std::string& branch, const FetchOptions& options) {
     std::string repo_path = generate_repo_path(repo_url);
 
-    // 如果目录已存在，先删除
+    // 无法打开的镜像视为损坏，只有这种情况才会重新下载
     if (fs::exists(repo_path)) {
+        Logger::warn("Mirror is unusable, recreating: " + repo_path);
         fs::remove_all(repo_path);
     }
 
-    int error = git_clone(&repo, repo_url.c_str(), repo_path.c_str(), &clone_opts);
-    handle_error(error, "Git clone");
-
-    git_repository_free(repo);
+    git_repository* raw_repo = nullptr;
+    int error = git_repository_init(&raw_repo, repo_path.c_str(), 1);
+    RepoPtr repo(raw_repo, git_repository_free);
+    handle_error(error, "Init mirror");
+
+    git_remote* raw_remote = nullptr;
+    error = git_remote_create_with_fetchspec(&raw_remote, repo.get(), "origin", repo_url.c_str(),
+                                             "+refs/heads/*:refs/remotes/origin/*");
+    RemotePtr remote(raw_remote, git_remote_free);
+    handle_error(error, "Create remote origin");
+    remote.reset();
+
+    static const Histogram clone_duration = Metrics::histogram(
+        "lisa_git_fetch_duration_seconds", "Duration of mirror clones and pulls", kGitFetchBuckets, {{"operation", "clone"}});
+    ScopedTimer timer(clone_duration);
+    try {
+        fetch_branch(repo.get(), branch, effective_depth(options));
+    } catch (const std::exception&) {
+        // 首次获取失败（如地址错误）时删除新建的镜像，未记录使用的目录不会被缓存清理发现
+        repo.reset();
+        std::error_code ec;
+        fs::remove_all(repo_path, ec);
+        throw;
+    }
     return repo_path;
 }
 
-bool GitHandler::pull_repo(const std::string& repo_path, const std::string& branch) {
-    git_repository* repo = nullptr;
-    int error = git_repository_open(&repo, repo_path.c_str());
+bool GitHandler::pull_repo(const std::string& repo_path, const std::string& branch, const FetchOptions& options) {
+    git_repository* raw_repo = nullptr;
+    int error = git_repository_open_bare(&raw_repo, repo_path.c_str());
+    RepoPtr repo(raw_repo, git_repository_free);
     if (error < 0) return false;
 
-    git_remote* origin = nullptr;
-    error = git_remote_lookup(&origin, repo, "origin");
-    handle_error(error, "Lookup remote origin");
+    // 完整镜像保持完整，增量获取本身只传输新对象；浅镜像按请求深度获取，
+    // 请求完整历史时补全
+    int depth = 0;
+    if (git_repository_is_shallow(repo.get()) == 1) {
+        depth = effective_depth(options);
+#if LISA_GIT_SHALLOW_SUPPORTED
+        if (depth == 0) {
+            depth = GIT_FETCH_DEPTH_UNSHALLOW;
+        }
+#endif
+    }
 
-    // 拉取最新代码
-    error = git_remote_fetch(origin, nullptr, nullptr, nullptr);
-    handle_error(error, "Fetch from remote");
+    static const Histogram pull_duration = Metrics::histogram(
+        "lisa_git_fetch_duration_seconds", "Duration of mirror clones and pulls", kGitFetchBuckets, {{"operation", "pull"}});
+    ScopedTimer timer(pull_duration);
+    fetch_branch(repo.get(), branch, depth);
+    return true;
+}
 
-    // 检出指定分支
-    git_reference* ref = nullptr;
-    error = git_branch_lookup(&ref, repo, branch.c_str(), GIT_BRANCH_LOCAL);
-    handle_error(error, "Lookup branch: " + branch);
+std::string GitHandler::resolve_commit(const std::string& repo_path, const std::string& branch, const std::string& commit_hash) {
+    git_repository* raw_repo = nullptr;
+    int error = git_repository_open_bare(&raw_repo, repo_path.c_str());
+    RepoPtr repo(raw_repo, git_repository_free);
+    handle_error(error, "Open mirror");
+
+    std::string spec = (commit_hash.empty() ? "refs/remotes/origin/" + branch : commit_hash) + "^{commit}";
+    git_object* raw_commit = nullptr;
+    error = git_revparse_single(&raw_commit, repo.get(), spec.c_str());
+
+#if LISA_GIT_SHALLOW_SUPPORTED
+    // 指定的提交不在浅镜像的历史范围内时，补全历史后重试
+    if (error == GIT_ENOTFOUND && !commit_hash.empty() && git_repository_is_shallow(repo.get()) == 1) {
+        Logger::info("Commit " + commit_hash + " not in shallow mirror, fetching full history: " + repo_path);
+        fetch_branch(repo.get(), branch, GIT_FETCH_DEPTH_UNSHALLOW);
+        error = git_revparse_single(&raw_commit, repo.get(), spec.c_str());
+    }
+#endif
 
-    git_commit* commit = nullptr;
-    error = git_reference_peel(&commit, ref, GIT_OBJECT_COMMIT);
-    handle_error(error, "Peel branch reference");
+    ObjectPtr commit(raw_commit, git_object_free);
+    handle_error(error, "Resolve commit: " + spec);
 
-    git_checkout_options checkout_opts = GIT_CHECKOUT_OPTIONS_INIT;
-    checkout_opts.checkout_strategy = GIT_CHECKOUT_FORCE;
-    error = git_checkout_tree(repo, reinterpret_cast<git_object*>(commit), &checkout_opts);
-    handle_error(error, "Checkout tree");
+    char hex[GIT_OID_HEXSZ + 1];
+    git_oid_tostr(hex, sizeof(hex), git_object_id(commit.get()));
+    return hex;
+}
 
-    error = git_repository_set_head(repo, git_reference_name(ref));
-    handle_error(error, "Set head to branch: " + branch);
+std::string GitHandler::create_checkout(const std::string& repo_url, const std::string& repo_path, const std::string& commit_id) {
+    std::string checkout_path = checkout_root_ + "/" + repo_key(repo_url) + "/" + std::to_string(++checkout_seq_);
 
-    git_commit_free(commit);
-    git_reference_free(ref);
-    git_remote_free(origin);
-    git_repository_free(repo);
-    return true;
+    // 先登记检出目录，使镜像在检出期间不会被淘汰
+    {
+        std::lock_guard<std::mutex> lock(last_used_mutex_);
+        checkouts_[checkout_path] = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    }
+
+    try {
+        init_checkout(repo_path, checkout_path);
+        checkout_commit(checkout_path, commit_id);
+    } catch (...) {
+        release_checkout(checkout_path);
+        throw;
+    }
+
+    return checkout_path;
+}
+
+void GitHandler::init_checkout(const std::string& repo_path, const std::string& checkout_path) {
+    git_repository* raw_repo = nullptr;
+    int error = git_repository_init(&raw_repo, checkout_path.c_str(), 0);
+    RepoPtr repo(raw_repo, git_repository_free);
+    handle_error(error, "Init checkout");
+    repo.reset();
+
+    // 通过alternates引用镜像的对象库，检出目录本身不保存任何对象
+    fs::create_directories(checkout_path + "/.git/objects/info");
+    std::ofstream alternates(checkout_path + "/.git/objects/info/alternates");
+    alternates << fs::absolute(repo_path + "/objects").string() << "\n";
+    alternates.close();
+    if (!alternates) {
+        throw std::runtime_error("Failed to write alternates for checkout: " + checkout_path);
+    }
+}
+
+std::string GitHandler::warm_worktree(const std::string& repo_url, const std::string& name, const std::string& commit_id) {
+    std::string worktree_path = checkout_root_ + "/" + repo_key(repo_url) + "/warm-" + name;
+
+    // 登记后镜像不会被淘汰；目录本身也按检出目录参与LRU淘汰，被淘汰后下次重新创建。
+    // 淘汰在同一把路径锁下删除目录，持锁期间不会删到一半
+    std::lock_guard<std::mutex> repo_guard(repo_lock(worktree_path));
+    {
+        std::lock_guard<std::mutex> lock(last_used_mutex_);
+        checkouts_[worktree_path] = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    }
+
+    try {
+        if (!fs::exists(worktree_path + "/.git")) {
+            fs::remove_all(worktree_path);
+            init_checkout(generate_repo_path(repo_url), worktree_path);
+        }
+
+        // 检出只改写与新提交不同的文件，未变化文件的mtime保持不变，未跟踪的构建产物保留
+        checkout_commit(worktree_path, commit_id);
+    } catch (...) {
+        release_checkout(worktree_path);
+        throw;
+    }
+    return worktree_path;
 }
 
 std::string GitHandler::clone_or_pull(const std::string& repo_url, const std::string& branch, const std::string& commit_hash) {
-    std::lock_guard<std::mutex> lock(repo_mutex_);
+    return clone_or_pull(repo_url, branch, commit_hash, default_fetch_options_);
+}
+
+std::string GitHandler::clone_or_pull(const std::string& repo_url, const std::string& branch, const std::string& commit_hash,
+                                      const FetchOptions& options) {
+    validate_fetch_options(options);
+
     std::string repo_path = generate_repo_path(repo_url);
+    std::string commit_id = fetch_commit(repo_url, branch, commit_hash, options);
+
+    // 检出只读取镜像对象，不需要持有仓库锁，同一仓库的多个任务可并行检出
+    std::string checkout_path = create_checkout(repo_url, repo_path, commit_id);
+    Logger::info("Checked out " + commit_id + " of " + repo_url + " to " + checkout_path);
+    return checkout_path;
+}
 
+std::string GitHandler::snapshot(const std::string& repo_url, const std::string& commit_id) {
+    std::string snapshot_path = checkout_root_ + "/" + repo_key(repo_url) + "/" + commit_id;
+
+    // 同一提交的并发请求只创建一次快照
+    std::lock_guard<std::mutex> repo_guard(repo_lock(snapshot_path));
+    {
+        std::lock_guard<std::mutex> lock(last_used_mutex_);
+        auto it = checkouts_.find(snapshot_path);
+        if (it != checkouts_.end()) {
+            it->second = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+            return snapshot_path;
+        }
+    }
+
+    // 先检出到临时目录，完整后再改名，其他任务不会看到半成品
+    std::string checkout_path = create_checkout(repo_url, generate_repo_path(repo_url), commit_id);
     try {
-        if (fs::exists(repo_path)) {
-            Logger::info("Pulling updates for repo: " + repo_url);
-            pull_repo(repo_path, branch);
-        } else {
-            Logger::info("Cloning new repo: " + repo_url);
-            repo_path = clone_repo(repo_url, branch);
+        // 快照文件会被硬链接到任务工作目录，去掉写权限防止非 root 的构建原地修改共享的源文件
+        for (const auto& entry : fs::recursive_directory_iterator(checkout_path)) {
+            if (entry.is_regular_file() && !entry.is_symlink()) {
+                fs::permissions(entry.path(),
+                                fs::perms::owner_write | fs::perms::group_write | fs::perms::others_write,
+                                fs::perm_options::remove);
+            }
         }
+        fs::remove_all(snapshot_path);
+
+        std::lock_guard<std::mutex> lock(last_used_mutex_);
+        fs::rename(checkout_path, snapshot_path);
+        checkouts_.erase(checkout_path);
+        checkouts_[snapshot_path] = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    } catch (...) {
+        release_checkout(checkout_path);
+        throw;
+    }
+
+    Logger::info("Created snapshot of " + commit_id + " of " + repo_url + " at " + snapshot_path);
+    return snapshot_path;
+}
+
+std::string GitHandler::tree_id(const std::string& repo_url, const std::string& commit_id) {
+    git_repository* raw_repo = nullptr;
+    int error = git_repository_open_bare(&raw_repo, generate_repo_path(repo_url).c_str());
+    RepoPtr repo(raw_repo, git_repository_free);
+    handle_error(error, "Open mirror");
+
+    git_oid oid;
+    error = git_oid_fromstr(&oid, commit_id.c_str());
+    handle_error(error, "Parse commit hash: " + commit_id);
+
+    git_commit* raw_commit = nullptr;
+    error = git_commit_lookup(&raw_commit, repo.get(), &oid);
+    std::unique_ptr<git_commit, void (*)(git_commit*)> commit(raw_commit, git_commit_free);
+    handle_error(error, "Lookup commit: " + commit_id);
+
+    char hex[GIT_OID_HEXSZ + 1];
+    git_oid_tostr(hex, sizeof(hex), git_commit_tree_id(commit.get()));
+    return hex;
+}
 
-        // 如果指定了commit hash，检出特定提交
-        if (!commit_hash.empty()) {
-            checkout_commit(repo_path, commit_hash);
+std::optional<std::string> GitHandler::find_local_commit(const std::string& repo_path, const std::string& commit_hash) {
+    git_repository* raw_repo = nullptr;
+    if (git_repository_open_bare(&raw_repo, repo_path.c_str()) < 0) {
+        return std::nullopt;
+    }
+    RepoPtr repo(raw_repo, git_repository_free);
+
+    git_object* raw_commit = nullptr;
+    if (git_revparse_single(&raw_commit, repo.get(), (commit_hash + "^{commit}").c_str()) < 0) {
+        return std::nullopt;
+    }
+    ObjectPtr commit(raw_commit, git_object_free);
+
+    char hex[GIT_OID_HEXSZ + 1];
+    git_oid_tostr(hex, sizeof(hex), git_object_id(commit.get()));
+    return std::string(hex);
+}
+
+std::string GitHandler::fetch_commit(const std::string& repo_url, const std::string& branch, const std::string& commit_hash,
+                                     const FetchOptions& options) {
+    std::string repo_path = generate_repo_path(repo_url);
+    ++fetch_requests_;
+
+    std::string commit_id;
+    if (!commit_hash.empty()) {
+        // 提交不可变，镜像中已存在时无需访问网络
+        if (auto local_commit = find_local_commit(repo_path, commit_hash)) {
+            ++served_locally_;
+            commit_id = *local_commit;
+        }
+    } else {
+        // 新鲜度窗口内的分支直接复用上次获取的结果
+        std::lock_guard<std::mutex> lock(inflight_mutex_);
+        auto it = fresh_refs_.find(repo_url + "#refs/heads/" + branch);
+        if (it != fresh_refs_.end() &&
+            std::chrono::steady_clock::now() - it->second.fetched_at < std::chrono::seconds(fetch_freshness_seconds_)) {
+            ++served_locally_;
+            commit_id = it->second.commit_id;
         }
+    }
+
+    if (commit_id.empty()) {
+        commit_id = coalesced_fetch(repo_url, branch, commit_hash, options);
+    }
 
-        // 更新最后使用时间
-        repo_last_used_[repo_path] = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    // 获取成功后才记录使用，地址错误的仓库不会进入预取列表
+    record_use(repo_path, repo_url, branch);
+    return commit_id;
+}
+
+std::string GitHandler::coalesced_fetch(const std::string& repo_url, const std::string& branch, const std::string& commit_hash,
+                                        const FetchOptions& options) {
+    std::string branch_key = repo_url + "#refs/heads/" + branch;
+    std::string fetch_key = commit_hash.empty() ? branch_key : repo_url + "#" + commit_hash;
+
+    std::promise<std::string> promise;
+    std::shared_future<std::string> result;
+    bool leader = false;
+    {
+        std::lock_guard<std::mutex> lock(inflight_mutex_);
+        auto it = inflight_fetches_.find(fetch_key);
+        if (it != inflight_fetches_.end()) {
+            result = it->second;
+        } else {
+            result = promise.get_future().share();
+            inflight_fetches_[fetch_key] = result;
+            leader = true;
+        }
+    }
 
-        return repo_path;
+    if (!leader) {
+        Logger::debug("Joining in-flight fetch: " + fetch_key);
+        return result.get();
+    }
+
+    try {
+        std::string commit_id = update_mirror(repo_url, branch, commit_hash, options);
+        promise.set_value(commit_id);
+
+        std::lock_guard<std::mutex> lock(inflight_mutex_);
+        inflight_fetches_.erase(fetch_key);
+        if (commit_hash.empty()) {
+            fresh_refs_[branch_key] = {commit_id, std::chrono::steady_clock::now()};
+        }
+        return commit_id;
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+        std::lock_guard<std::mutex> lock(inflight_mutex_);
+        inflight_fetches_.erase(fetch_key);
+        throw;
+    }
+}
+
+bool GitHandler::prefetch(const std::string& repo_url, const std::string& branch) {
+    try {
+        coalesced_fetch(repo_url, branch, "", default_fetch_options_);
+        ++prefetches_;
+        return true;
     } catch (const std::exception& e) {
-        Logger::error("Error processing repo: " + std::string(e.what()));
-        // 如果失败且目录存在，尝试删除后重新克隆
+        ++prefetch_failures_;
+        Logger::warn("Prefetch of " + repo_url + " (" + branch + ") failed: " + e.what());
+        return false;
+    }
+}
+
+std::vector<PrefetchTarget> GitHandler::hot_repos(size_t top_k, time_t max_idle_seconds) {
+    time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+
+    std::vector<const RepoUsage*> candidates;
+    std::vector<PrefetchTarget> targets;
+    std::lock_guard<std::mutex> lock(last_used_mutex_);
+
+    for (const auto& entry : repo_usage_) {
+        const RepoUsage& usage = entry.second;
+        if (!usage.repo_url.empty() && !usage.branches.empty() && now - usage.last_used <= max_idle_seconds) {
+            candidates.push_back(&usage);
+        }
+    }
+
+    // 使用次数优先，次数相同时最近使用的优先
+    std::sort(candidates.begin(), candidates.end(), [](const RepoUsage* a, const RepoUsage* b) {
+        if (a->use_count != b->use_count) return a->use_count > b->use_count;
+        return a->last_used > b->last_used;
+    });
+    if (candidates.size() > top_k) {
+        candidates.resize(top_k);
+    }
+
+    for (const auto* usage : candidates) {
+        targets.push_back({usage->repo_url, usage->branches});
+    }
+    return targets;
+}
+
+FetchStats GitHandler::fetch_stats() const {
+    FetchStats stats;
+    stats.requests = fetch_requests_;
+    stats.served_locally = served_locally_;
+    stats.prefetches = prefetches_;
+    stats.prefetch_failures = prefetch_failures_;
+    return stats;
+}
+
+std::string GitHandler::update_mirror(const std::string& repo_url, const std::string& branch, const std::string& commit_hash,
+                                      const FetchOptions& options) {
+    std::string repo_path = generate_repo_path(repo_url);
+
+    // 只串行化同一仓库的镜像更新，其他仓库的拉取不受影响
+    std::lock_guard<std::mutex> lock(repo_lock(repo_path));
+
+    std::string commit_id;
+    try {
+        bool fetched = false;
         if (fs::exists(repo_path)) {
-            fs::remove_all(repo_path);
+            Logger::info("Fetching updates for repo: " + repo_url);
+            fetched = pull_repo(repo_path, branch, options);
+        }
+        if (!fetched) {
+            Logger::info("Creating mirror for repo: " + repo_url);
+            clone_repo(repo_url, branch, options);
         }
-        return clone_repo(repo_url, branch);
+
+        commit_id = resolve_commit(repo_path, branch, commit_hash);
+    } catch (const std::exception& e) {
+        // 获取失败时保留镜像，已下载的对象下次仍可复用
+        Logger::error("Error processing repo: " + std::string(e.what()));
+        throw;
     }
+
+    return commit_id;
 }
 
 bool GitHandler::checkout_commit(const std::string& repo_path, const std::string& commit_hash) {
-    git_repository* repo = nullptr;
-    int error = git_repository_open(&repo, repo_path.c_str());
+    git_repository* raw_repo = nullptr;
+    int error = git_repository_open(&raw_repo, repo_path.c_str());
+    RepoPtr repo(raw_repo, git_repository_free);
     handle_error(error, "Open repository");
 
-    git_object* commit = nullptr;
-    error = git_object_lookup(&commit, repo, git_oid_fromstr(commit_hash.c_str()), GIT_OBJECT_COMMIT);
+    git_oid oid;
+    error = git_oid_fromstr(&oid, commit_hash.c_str());
+    handle_error(error, "Parse commit hash: " + commit_hash);
+
+    git_object* raw_commit = nullptr;
+    error = git_object_lookup(&raw_commit, repo.get(), &oid, GIT_OBJECT_COMMIT);
+    ObjectPtr commit(raw_commit, git_object_free);
     handle_error(error, "Lookup commit: " + commit_hash);
 
     git_checkout_options checkout_opts = GIT_CHECKOUT_OPTIONS_INIT;
     checkout_opts.checkout_strategy = GIT_CHECKOUT_FORCE;
-    error = git_checkout_tree(repo, commit, &checkout_opts);
+    error = git_checkout_tree(repo.get(), commit.get(), &checkout_opts);
     handle_error(error, "Checkout commit: " + commit_hash);
 
-    git_object_free(commit);
-    git_repository_free(repo);
+    error = git_repository_set_head_detached(repo.get(), &oid);
+    handle_error(error, "Detach head at: " + commit_hash);
+
     return true;
 }
 
+void GitHandler::release_checkout(const std::string& checkout_path) {
+    {
+        std::lock_guard<std::mutex> lock(last_used_mutex_);
+        if (checkouts_.erase(checkout_path) == 0) {
+            return;
+        }
+    }
+    fs::remove_all(checkout_path);
+}
+
 time_t GitHandler::get_last_modified_time(const std::string& repo_path) {
-    std::lock_guard<std::mutex> lock(repo_mutex_);
-    auto it = repo_last_used_.find(repo_path);
-    if (it != repo_last_used_.end()) {
-        return it->second;
+    std::lock_guard<std::mutex> lock(last_used_mutex_);
+    auto it = repo_usage_.find(repo_path);
+    if (it != repo_usage_.end()) {
+        return it->second.last_used;
     }
     return 0;
 }
 
-void GitHandler::clean_expired_repos(time_t max_age_seconds) {
-    std::lock_guard<std::mutex> lock(repo_mutex_);
+void GitHandler::clean_expired_repos(time_t max_age_seconds, const std::unordered_set<std::string>& active_checkouts) {
     time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
 
-    for (auto it = repo_last_used_.begin(); it != repo_last_used_.end();) {
-        if (now - it->second > max_age_seconds) {
-            Logger::info("Cleaning expired repo: " + it->first);
-            fs::remove_all(it->first);
-            it = repo_last_used_.erase(it);
+    // 先在短临界区内收集候选目录，避免持锁删除目录；任务正在使用的检出目录（含就地构建的热目录）
+    // 无论多久未更新都保留，其引用的镜像也随之保留
+    std::vector<std::string> expired_checkouts;
+    std::vector<std::string> expired;
+    {
+        std::lock_guard<std::mutex> lock(last_used_mutex_);
+        std::unordered_set<std::string> referenced_mirrors;
+        for (auto it = checkouts_.begin(); it != checkouts_.end();) {
+            if (now - it->second > max_age_seconds && active_checkouts.count(it->first) == 0) {
+                expired_checkouts.push_back(it->first);
+                it = checkouts_.erase(it);
+            } else {
+                referenced_mirrors.insert(mirror_for_checkout(it->first));
+                ++it;
+            }
+        }
+        for (const auto& entry : repo_usage_) {
+            if (now - entry.second.last_used > max_age_seconds && referenced_mirrors.count(entry.first) == 0) {
+                expired.push_back(entry.first);
+            }
+        }
+    }
+
+    // 检出目录依赖镜像对象库，必须先于镜像删除
+    for (const auto& checkout_path : expired_checkouts) {
+        Logger::info("Cleaning expired checkout: " + checkout_path);
+        fs::remove_all(checkout_path);
+    }
+
+    for (const auto& repo_path : expired) {
+        // 仓库正在被克隆或拉取时跳过，下次清理再处理
+        std::unique_lock<std::mutex> repo_guard(repo_lock(repo_path), std::try_to_lock);
+        if (!repo_guard.owns_lock()) {
+            continue;
+        }
+
+        {
+            // 获取分片锁期间可能已被重新使用
+            std::lock_guard<std::mutex> lock(last_used_mutex_);
+            auto it = repo_usage_.find(repo_path);
+            if (it == repo_usage_.end() || now - it->second.last_used <= max_age_seconds) {
+                continue;
+            }
+        }
+
+        Logger::info("Cleaning expired repo: " + repo_path);
+        remove_mirror(repo_path);
+    }
+}
+
+std::string GitHandler::mirror_for_checkout(const std::string& checkout_path) {
+    // 检出目录布局为 checkouts/<仓库键>/<序号>，镜像为 mirrors/<仓库键>.git
+    return mirror_root_ + "/" + fs::path(checkout_path).parent_path().filename().string() + ".git";
+}
+
+void GitHandler::remove_mirror(const std::string& repo_path) {
+    std::string repo_url;
+    {
+        std::lock_guard<std::mutex> lock(last_used_mutex_);
+        auto it = repo_usage_.find(repo_path);
+        if (it != repo_usage_.end()) {
+            repo_url = it->second.repo_url;
+            repo_usage_.erase(it);
+        }
+    }
+
+    if (!repo_url.empty()) {
+        clear_fresh_refs(repo_url);
+    }
+    fs::remove_all(repo_path);
+}
+
+void GitHandler::clear_fresh_refs(const std::string& repo_url) {
+    // 镜像删除后不能再复用之前解析的分支结果
+    std::lock_guard<std::mutex> lock(inflight_mutex_);
+    std::string prefix = repo_url + "#";
+    for (auto it = fresh_refs_.begin(); it != fresh_refs_.end();) {
+        if (it->first.compare(0, prefix.size(), prefix) == 0) {
+            it = fresh_refs_.erase(it);
         } else {
             ++it;
         }
     }
-}
\ No newline at end of file
+}
+
+std::vector<CacheEntry> GitHandler::cache_entries(const std::unordered_set<std::string>& active_checkouts) {
+    std::vector<CacheEntry> entries;
+    std::unordered_set<std::string> referenced_mirrors;
+
+    std::lock_guard<std::mutex> lock(last_used_mutex_);
+    for (const auto& entry : checkouts_) {
+        entries.push_back({entry.first, entry.second, active_checkouts.count(entry.first) > 0});
+        referenced_mirrors.insert(mirror_for_checkout(entry.first));
+    }
+
+    // 仍有检出目录通过alternates引用的镜像不可淘汰
+    for (const auto& entry : repo_usage_) {
+        entries.push_back({entry.first, entry.second.last_used, referenced_mirrors.count(entry.first) > 0});
+    }
+    return entries;
+}
+
+bool GitHandler::evict(const std::string& path, time_t listed_last_used,
+                       const std::unordered_set<std::string>& active_checkouts) {
+    // 持有路径锁：snapshot() 和 warm_worktree() 在同一把锁下重建目录，不会与删除交错
+    std::unique_lock<std::mutex> repo_guard(repo_lock(path), std::try_to_lock);
+    if (!repo_guard.owns_lock()) {
+        return false;
+    }
+
+    // 列出条目后测量大小可能耗时很久，期间条目可能被重新使用：最后使用时间变化或已被任务使用时不淘汰。
+    // 在同一临界区内移除登记，之后的请求会重新创建目录，而不是拿到正在删除的路径
+    std::string repo_url;
+    {
+        std::lock_guard<std::mutex> lock(last_used_mutex_);
+        if (path.compare(0, checkout_root_.size(), checkout_root_) == 0) {
+            auto it = checkouts_.find(path);
+            if (it == checkouts_.end() || it->second != listed_last_used || active_checkouts.count(path) > 0) {
+                return false;
+            }
+            checkouts_.erase(it);
+        } else {
+            auto it = repo_usage_.find(path);
+            if (it == repo_usage_.end() || it->second.last_used != listed_last_used) {
+                return false;
+            }
+            // 仍有检出目录通过alternates引用时不淘汰
+            for (const auto& entry : checkouts_) {
+                if (mirror_for_checkout(entry.first) == path) {
+                    return false;
+                }
+            }
+            repo_url = it->second.repo_url;
+            repo_usage_.erase(it);
+        }
+    }
+
+    if (!repo_url.empty()) {
+        clear_fresh_refs(repo_url);
+    }
+    fs::remove_all(path);
+    return true;
+}
@@ -5,44 +5,196 @@
 #include <git2.h>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <mutex>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <optional>
+#include "cache_entry.h"
 #include "logger.h"
 
 namespace lisa::server {
 
+// 仓库获取选项
+struct FetchOptions {
+    int depth = 0;          // 浅克隆深度，0 表示完整历史
+    std::string filter;     // 部分克隆过滤器，如 "blob:none"，为空表示不过滤
+};
+
+// 仓库获取统计
+struct FetchStats {
+    uint64_t requests = 0;            // 获取请求总数
+    uint64_t served_locally = 0;      // 无需访问网络即完成的请求数
+    uint64_t prefetches = 0;          // 后台预取成功次数
+    uint64_t prefetch_failures = 0;   // 后台预取失败次数
+};
+
+// 预取目标：仓库及其最近使用的分支
+struct PrefetchTarget {
+    std::string repo_url;
+    std::vector<std::string> branches;
+};
+
 class GitHandler {
 public:
-    GitHandler(const std::string& base_repo_path);
+    GitHandler(const std::string& base_repo_path, const FetchOptions& default_fetch_options = {},
+               time_t fetch_freshness_seconds = 0);
     ~GitHandler();
 
-    // 克隆或拉取仓库
+    // 更新仓库镜像，并为本次任务创建指定提交的独立检出目录，返回检出目录路径
     std::string clone_or_pull(const std::string& repo_url, const std::string& branch = "main", const std::string& commit_hash = "");
 
-    // 检查特定提交是否存在并检出
+    // 同上，使用指定的获取选项
+    std::string clone_or_pull(const std::string& repo_url, const std::string& branch, const std::string& commit_hash,
+                              const FetchOptions& options);
+
+    // 更新镜像并解析目标提交，返回完整的提交哈希；相同引用的并发请求只获取一次
+    std::string fetch_commit(const std::string& repo_url, const std::string& branch, const std::string& commit_hash,
+                             const FetchOptions& options);
+
+    // 后台预取仓库分支，不计入使用记录
+    bool prefetch(const std::string& repo_url, const std::string& branch);
+
+    // 按使用次数和最近使用时间选出最热的仓库，忽略空闲超过 max_idle_seconds 的仓库
+    std::vector<PrefetchTarget> hot_repos(size_t top_k, time_t max_idle_seconds);
+
+    // 获取统计信息
+    FetchStats fetch_stats() const;
+
+    // 获取已获取提交的共享只读快照目录，同一提交的任务共用一份，不存在时创建
+    std::string snapshot(const std::string& repo_url, const std::string& commit_id);
+
+    // 将名为 name 的可写工作树更新到指定提交，不存在时创建；保留未跟踪文件，用于增量构建
+    std::string warm_worktree(const std::string& repo_url, const std::string& name, const std::string& commit_id);
+
+    // 获取提交对应的树对象哈希，内容相同的提交树哈希相同
+    std::string tree_id(const std::string& repo_url, const std::string& commit_id);
+
+    // 获取服务器默认的获取选项
+    const FetchOptions& default_fetch_options() const { return default_fetch_options_; }
+
+    // 校验获取选项，不合法时抛出 std::invalid_argument
+    static void validate_fetch_options(const FetchOptions& options);
+
+    // 在检出目录中检出指定提交
     bool checkout_commit(const std::string& repo_path, const std::string& commit_hash);
 
-    // 获取仓库的最后修改时间
+    // 释放任务检出目录（镜像保留）
+    void release_checkout(const std::string& checkout_path);
+
+    // 获取仓库镜像的最后使用时间
     time_t get_last_modified_time(const std::string& repo_path);
 
-    // 清理过期的仓库缓存
-    void clean_expired_repos(time_t max_age_seconds);
+    // 清理过期的检出目录和仓库镜像；active_checkouts 为活动任务正在使用的检出目录，不清理
+    void clean_expired_repos(time_t max_age_seconds, const std::unordered_set<std::string>& active_checkouts);
+
+    // 列出可淘汰的检出目录和仓库镜像；active_checkouts 为活动任务正在使用的检出目录
+    std::vector<CacheEntry> cache_entries(const std::unordered_set<std::string>& active_checkouts);
+
+    // 淘汰一个检出目录或仓库镜像；listed_last_used 为列出条目时的最后使用时间。
+    // 条目此后被重新使用、被活动任务使用、镜像仍被检出目录引用或正在获取时返回false
+    bool evict(const std::string& path, time_t listed_last_used, const std::unordered_set<std::string>& active_checkouts);
+
+    // 获取仓库缓存根目录
+    const std::string& base_repo_path() const { return base_repo_path_; }
 
 private:
+    // 仓库锁分片数量：同一仓库的操作串行，不同仓库的操作并行
+    static constexpr size_t kRepoLockShards = 64;
+
+    // 每个仓库最多记录的最近使用分支数
+    static constexpr size_t kMaxTrackedBranches = 4;
+
+    // 仓库使用记录
+    struct RepoUsage {
+        std::string repo_url;
+        time_t last_used = 0;
+        uint64_t use_count = 0;
+        std::vector<std::string> branches;   // 最近使用的分支，越靠前越新
+    };
+
+    // 最近一次获取的分支结果
+    struct FreshRef {
+        std::string commit_id;
+        std::chrono::steady_clock::time_point fetched_at;
+    };
+
     std::string base_repo_path_;
-    std::unordered_map<std::string, time_t> repo_last_used_;
-    std::mutex repo_mutex_;
+    FetchOptions default_fetch_options_;
+    time_t fetch_freshness_seconds_;                          // 分支获取结果的复用窗口(秒)
+    std::string mirror_root_;                                 // 裸镜像目录，每个远程URL一个
+    std::string checkout_root_;                               // 任务检出目录，借助alternates共享镜像对象
+    std::unordered_map<std::string, RepoUsage> repo_usage_;   // 镜像路径 -> 使用记录
+    std::unordered_map<std::string, time_t> checkouts_;       // 检出路径 -> 创建时间
+    std::mutex last_used_mutex_;                              // 保护 repo_usage_ 和 checkouts_
+    std::array<std::mutex, kRepoLockShards> repo_locks_;      // 按仓库路径分片的锁表
+    std::atomic<uint64_t> checkout_seq_;                      // 检出目录序号
+    std::unordered_map<std::string, std::shared_future<std::string>> inflight_fetches_; // 正在进行的获取
+    std::unordered_map<std::string, FreshRef> fresh_refs_;    // URL#分支 -> 最近获取结果
+    std::mutex inflight_mutex_;                               // 保护 inflight_fetches_ 和 fresh_refs_
+    std::atomic<uint64_t> fetch_requests_;
+    std::atomic<uint64_t> served_locally_;
+    std::atomic<uint64_t> prefetches_;
+    std::atomic<uint64_t> prefetch_failures_;
+
+    // 获取仓库路径对应的分片锁
+    std::mutex& repo_lock(const std::string& repo_path);
+
+    // 记录一次仓库使用
+    void record_use(const std::string& repo_path, const std::string& repo_url, const std::string& branch);
+
+    // 检出目录所属的镜像路径
+    std::string mirror_for_checkout(const std::string& checkout_path);
+
+    // 删除镜像及其记录，调用方须持有该仓库的分片锁
+    void remove_mirror(const std::string& repo_path);
+
+    // 丢弃仓库所有分支的新鲜度记录
+    void clear_fresh_refs(const std::string& repo_url);
 
-    // 生成仓库的本地存储路径
+    // 合并相同引用的并发获取，后来者等待并共享结果
+    std::string coalesced_fetch(const std::string& repo_url, const std::string& branch, const std::string& commit_hash,
+                                const FetchOptions& options);
+
+    // 由URL生成稳定的目录名（仓库名 + URL哈希前缀）
+    std::string repo_key(const std::string& repo_url);
+
+    // 生成仓库镜像的本地存储路径
     std::string generate_repo_path(const std::string& repo_url);
 
     // 初始化libgit2
     void init_libgit2();
 
-    // 克隆仓库
-    std::string clone_repo(const std::string& repo_url, const std::string& branch);
+    // 创建裸镜像并首次获取指定分支，返回镜像路径
+    std::string clone_repo(const std::string& repo_url, const std::string& branch, const FetchOptions& options);
+
+    // 从远程获取指定分支的更新到镜像
+    bool pull_repo(const std::string& repo_path, const std::string& branch, const FetchOptions& options);
+
+    // 在仓库锁内更新镜像并解析目标提交
+    std::string update_mirror(const std::string& repo_url, const std::string& branch, const std::string& commit_hash,
+                              const FetchOptions& options);
+
+    // 查找镜像中已存在的提交，不访问网络
+    std::optional<std::string> find_local_commit(const std::string& repo_path, const std::string& commit_hash);
+
+    // 在镜像中解析目标提交，返回完整的提交哈希；浅镜像中找不到时补全历史后重试
+    std::string resolve_commit(const std::string& repo_path, const std::string& branch, const std::string& commit_hash);
+
+    // 将获取选项换算为libgit2的抓取深度
+    static int effective_depth(const FetchOptions& options);
+
+    // 以指定深度获取分支到镜像，depth 为 0 表示不限制深度
+    void fetch_branch(git_repository* repo, const std::string& branch, int depth);
+
+    // 创建借用镜像对象库的检出目录并检出指定提交
+    std::string create_checkout(const std::string& repo_url, const std::string& repo_path, const std::string& commit_id);
 
-    // 拉取仓库更新
-    bool pull_repo(const std::string& repo_path, const std::string& branch);
+    // 初始化引用镜像对象库的空检出目录
+    void init_checkout(const std::string& repo_path, const std::string& checkout_path);
 
     // 处理libgit2错误
     void handle_error(int error_code, const std::string& operation);
@@ -50,4 +202,4 @@ private:
 
 } // namespace lisa::server
 
-#endif // GIT_HANDLER_H
\ No newline at end of file
+#endif // GIT_HANDLER_H
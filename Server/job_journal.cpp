@@ -0,0 +1,278 @@
+#include "job_journal.h"
+#include "logger.h"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+using namespace lisa::server;
+
+namespace {
+
+const char* const kSegmentPrefix = "segment-";
+const char* const kSegmentSuffix = ".log";
+
+// 段文件名中的序号，不是段文件时返回空
+std::optional<uint64_t> parse_segment_name(const std::string& name) {
+    size_t prefix = std::strlen(kSegmentPrefix);
+    size_t suffix = std::strlen(kSegmentSuffix);
+    if (name.size() <= prefix + suffix || name.compare(0, prefix, kSegmentPrefix) != 0 ||
+        name.compare(name.size() - suffix, suffix, kSegmentSuffix) != 0) {
+        return std::nullopt;
+    }
+    std::string digits = name.substr(prefix, name.size() - prefix - suffix);
+    if (digits.find_first_not_of("0123456789") != std::string::npos) {
+        return std::nullopt;
+    }
+    return std::stoull(digits);
+}
+
+// 读写记录头中的小端32位整数
+uint32_t load_u32(const char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+void store_u32(char* data, uint32_t value) {
+    std::memcpy(data, &value, sizeof(value));
+}
+
+} // namespace
+
+JobJournal::JobJournal(const std::string& path, size_t segment_bytes)
+    : path_(path), output_path_(path + "/outputs"), segment_bytes_(segment_bytes) {
+    fs::create_directories(path_);
+    fs::create_directories(output_path_);
+
+    for (const auto& entry : fs::directory_iterator(path_)) {
+        if (auto sequence = parse_segment_name(entry.path().filename().string())) {
+            sealed_.push_back(*sequence);
+        }
+    }
+    std::sort(sealed_.begin(), sealed_.end());
+}
+
+JobJournal::~JobJournal() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_.fd >= 0) {
+        seal_segment();
+    }
+}
+
+std::string JobJournal::segment_path(uint64_t sequence) const {
+    char name[64];
+    std::snprintf(name, sizeof(name), "%s%016llu%s", kSegmentPrefix, static_cast<unsigned long long>(sequence),
+                  kSegmentSuffix);
+    return path_ + "/" + name;
+}
+
+std::string JobJournal::output_file(const std::string& job_id) const {
+    return output_path_ + "/" + job_id + ".log";
+}
+
+uint32_t JobJournal::checksum(const char* data, size_t size) {
+    // FNV-1a，只用于发现写了一半的记录
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+std::unordered_map<std::string, json> JobJournal::recover() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sealed_.empty() && current_.fd < 0) {
+        return {};
+    }
+
+    auto jobs = replay();
+    rewrite(jobs);
+    Logger::info("Recovered " + std::to_string(jobs.size()) + " jobs from journal " + path_);
+    return jobs;
+}
+
+void JobJournal::append(const std::string& job_id, const json& fields) {
+    std::string payload = json{{"id", job_id}, {"fields", fields}}.dump();
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_record(payload);
+}
+
+void JobJournal::remove(const std::string& job_id) {
+    std::string payload = json{{"id", job_id}, {"removed", true}}.dump();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        write_record(payload);
+    }
+
+    std::error_code ec;
+    fs::remove(output_file(job_id), ec);
+}
+
+void JobJournal::compact_if_needed() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sealed_.size() < kCompactSegments) {
+        return;
+    }
+
+    size_t segments = sealed_.size() + (current_.fd >= 0 ? 1 : 0);
+    auto jobs = replay();
+    rewrite(jobs);
+    Logger::info("Compacted job journal from " + std::to_string(segments) + " segments, " +
+                 std::to_string(jobs.size()) + " jobs kept");
+}
+
+void JobJournal::write_output(const std::string& job_id, const std::string& output) {
+    // 先写临时文件再改名，回放时不会读到写了一半的输出
+    std::string path = output_file(job_id);
+    std::string temp_path = path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file << output;
+        if (!file) {
+            throw std::runtime_error("Failed to write output of job " + job_id);
+        }
+    }
+    fs::rename(temp_path, path);
+}
+
+std::optional<std::string> JobJournal::read_output(const std::string& job_id) const {
+    std::ifstream file(output_file(job_id), std::ios::binary);
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void JobJournal::write_record(const std::string& payload) {
+    size_t needed = kHeaderBytes + payload.size();
+    if (current_.fd < 0 || current_.offset + needed > current_.size) {
+        uint64_t sequence = current_.fd >= 0 ? current_.sequence + 1 : (sealed_.empty() ? 1 : sealed_.back() + 1);
+        if (current_.fd >= 0) {
+            seal_segment();
+        }
+        open_segment(sequence, needed);
+    }
+
+    // 先写负载和校验和，最后写长度：进程在中途退出时该记录读出为段尾
+    char* record = current_.data + current_.offset;
+    std::memcpy(record + kHeaderBytes, payload.data(), payload.size());
+    store_u32(record + 4, checksum(payload.data(), payload.size()));
+    store_u32(record, static_cast<uint32_t>(payload.size()));
+    current_.offset += needed;
+}
+
+void JobJournal::open_segment(uint64_t sequence, size_t min_bytes) {
+    size_t size = std::max(segment_bytes_, min_bytes);
+    std::string path = segment_path(sequence);
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create journal segment " + path + ": " + std::strerror(errno));
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to size journal segment " + path + ": " + std::strerror(errno));
+    }
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Failed to map journal segment " + path + ": " + std::strerror(errno));
+    }
+
+    current_ = Segment{sequence, fd, static_cast<char*>(data), size, 0};
+}
+
+void JobJournal::seal_segment() {
+    // 映射写入的内容在页缓存中，服务器进程崩溃后仍会落盘；封存时再同步一次，覆盖断电的情况
+    munmap(current_.data, current_.size);
+    if (ftruncate(current_.fd, static_cast<off_t>(current_.offset)) != 0) {
+        Logger::warn("Failed to truncate journal segment " + segment_path(current_.sequence));
+    }
+    fdatasync(current_.fd);
+    close(current_.fd);
+    sealed_.push_back(current_.sequence);
+    current_ = Segment{};
+}
+
+std::unordered_map<std::string, json> JobJournal::replay() {
+    std::unordered_map<std::string, json> jobs;
+    auto apply = [&](const char* data, size_t size, const std::string& path) {
+        size_t offset = 0;
+        while (offset + kHeaderBytes <= size) {
+            uint32_t length = load_u32(data + offset);
+            if (length == 0) {
+                break;
+            }
+            const char* payload = data + offset + kHeaderBytes;
+            if (offset + kHeaderBytes + length > size || load_u32(data + offset + 4) != checksum(payload, length)) {
+                Logger::warn("Journal segment " + path + " has a torn record at offset " + std::to_string(offset));
+                break;
+            }
+
+            try {
+                json record = json::parse(payload, payload + length);
+                std::string job_id = record.at("id");
+                if (record.value("removed", false)) {
+                    jobs.erase(job_id);
+                } else {
+                    jobs[job_id].update(record.at("fields"));
+                }
+            } catch (const json::exception& e) {
+                Logger::warn("Skipping malformed journal record in " + path + ": " + e.what());
+            }
+            offset += kHeaderBytes + length;
+        }
+    };
+
+    for (uint64_t sequence : sealed_) {
+        std::string path = segment_path(sequence);
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                apply(static_cast<const char*>(data), static_cast<size_t>(st.st_size), path);
+                munmap(data, static_cast<size_t>(st.st_size));
+            }
+        }
+        close(fd);
+    }
+    if (current_.fd >= 0) {
+        apply(current_.data, current_.offset, segment_path(current_.sequence));
+    }
+    return jobs;
+}
+
+void JobJournal::rewrite(const std::unordered_map<std::string, json>& jobs) {
+    if (current_.fd >= 0) {
+        seal_segment();
+    }
+    std::vector<uint64_t> old_segments = sealed_;
+    sealed_.clear();
+
+    // 合并后的记录是任务的完整字段，新段写完并落盘前中断时，旧段仍可完整回放
+    open_segment(old_segments.empty() ? 1 : old_segments.back() + 1, kHeaderBytes);
+    for (const auto& entry : jobs) {
+        write_record(json{{"id", entry.first}, {"fields", entry.second}}.dump());
+    }
+    msync(current_.data, current_.size, MS_SYNC);
+
+    for (uint64_t sequence : old_segments) {
+        std::error_code ec;
+        fs::remove(segment_path(sequence), ec);
+    }
+}
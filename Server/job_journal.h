@@ -0,0 +1,95 @@
+#ifndef JOB_JOURNAL_H
+#define JOB_JOURNAL_H
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+namespace lisa::server {
+
+// 任务日志：只追加的任务状态日志，每条记录是某个任务的字段更新，回放时按任务ID合并。
+// 日志由固定大小的段文件组成，通过内存映射写入；任务结束后构建输出单独落盘，按需读取
+class JobJournal {
+public:
+    explicit JobJournal(const std::string& path, size_t segment_bytes = kDefaultSegmentBytes);
+    ~JobJournal();
+
+    // 禁止拷贝构造和赋值
+    JobJournal(const JobJournal&) = delete;
+    JobJournal& operator=(const JobJournal&) = delete;
+
+    // 回放日志，返回每个未删除任务合并后的字段，并把日志重写为只含这些任务的新段
+    std::unordered_map<std::string, nlohmann::json> recover();
+
+    // 追加任务字段的更新
+    void append(const std::string& job_id, const nlohmann::json& fields);
+
+    // 记录任务已删除，并删除其构建输出
+    void remove(const std::string& job_id);
+
+    // 封存的段过多时重写日志，丢弃已删除任务和被覆盖的字段
+    void compact_if_needed();
+
+    // 保存任务的构建输出
+    void write_output(const std::string& job_id, const std::string& output);
+
+    // 读取任务的构建输出，不存在时返回空
+    std::optional<std::string> read_output(const std::string& job_id) const;
+
+private:
+    static constexpr size_t kDefaultSegmentBytes = 4 * 1024 * 1024;
+
+    // 封存的段数达到该值时重写日志
+    static constexpr size_t kCompactSegments = 8;
+
+    // 记录头：负载长度和校验和，长度为0表示段内没有更多记录
+    static constexpr size_t kHeaderBytes = 8;
+
+    // 正在写入的段
+    struct Segment {
+        uint64_t sequence = 0;
+        int fd = -1;
+        char* data = nullptr;
+        size_t size = 0;
+        size_t offset = 0;   // 下一条记录的写入位置
+    };
+
+    std::string path_;
+    std::string output_path_;
+    size_t segment_bytes_;
+    std::vector<uint64_t> sealed_;   // 已封存的段序号，按写入先后排列
+    Segment current_;
+    std::mutex mutex_;
+
+    // 段文件路径
+    std::string segment_path(uint64_t sequence) const;
+
+    // 构建输出文件路径
+    std::string output_file(const std::string& job_id) const;
+
+    // 写入一条记录，空间不足时换到新段；调用方须持有 mutex_
+    void write_record(const std::string& payload);
+
+    // 创建并映射新段，可写空间至少为 min_bytes；调用方须持有 mutex_
+    void open_segment(uint64_t sequence, size_t min_bytes);
+
+    // 封存当前段：截断未使用的部分并解除映射；调用方须持有 mutex_
+    void seal_segment();
+
+    // 按序回放所有段，合并每个任务的字段；调用方须持有 mutex_
+    std::unordered_map<std::string, nlohmann::json> replay();
+
+    // 把合并后的状态写入新段并删除旧段；调用方须持有 mutex_
+    void rewrite(const std::unordered_map<std::string, nlohmann::json>& jobs);
+
+    // 计算记录负载的校验和
+    static uint32_t checksum(const char* data, size_t size);
+};
+
+} // namespace lisa::server
+
+#endif // JOB_JOURNAL_H
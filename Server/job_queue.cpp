@@ -0,0 +1,106 @@
+#include "job_queue.h"
+#include <stdexcept>
+#include <algorithm>
+
+using namespace lisa::server;
+
+namespace {
+
+// 租户权重，未配置的租户为 1
+double weight_of(const std::unordered_map<std::string, double>& tenant_weights, const std::string& tenant) {
+    auto it = tenant_weights.find(tenant);
+    return it != tenant_weights.end() ? it->second : 1.0;
+}
+
+} // namespace
+
+JobPriority lisa::server::parse_priority(const std::string& name) {
+    if (name == "high") return JobPriority::HIGH;
+    if (name == "normal") return JobPriority::NORMAL;
+    if (name == "low") return JobPriority::LOW;
+    throw std::invalid_argument("Unknown priority: " + name);
+}
+
+FairShareQueue::FairShareQueue(std::unordered_map<std::string, double> tenant_weights)
+    : tenant_weights_(std::move(tenant_weights)) {
+}
+
+void FairShareQueue::push(QueuedJob job, const std::string& tenant, JobPriority priority) {
+    Level& level = levels_[static_cast<size_t>(priority)];
+    TenantQueue& queue = level.tenants[tenant];
+    if (queue.jobs.empty()) {
+        level.active.push_back(tenant);
+    }
+    queue.jobs.push_back(std::move(job));
+    ++size_;
+}
+
+std::optional<std::string> FairShareQueue::pop() {
+    std::optional<QueuedJob> job = pop_from(levels_);
+    if (!job) {
+        return std::nullopt;
+    }
+    --size_;
+    return std::move(job->id);
+}
+
+std::optional<QueuedJob> FairShareQueue::pop_from(std::array<Level, 3>& levels) const {
+    for (Level& level : levels) {
+        // 每个任务的代价为 1：轮到的租户额度不足时补充一份权重并排到队尾
+        while (!level.active.empty()) {
+            std::string tenant = level.active.front();
+            TenantQueue& queue = level.tenants[tenant];
+            if (queue.deficit < 1.0) {
+                queue.deficit += weight_of(tenant_weights_, tenant);
+                level.active.pop_front();
+                level.active.push_back(tenant);
+                continue;
+            }
+
+            size_t index = selector_ ? std::min(selector_(queue.jobs), queue.jobs.size() - 1) : 0;
+            QueuedJob job = std::move(queue.jobs[index]);
+            queue.jobs.erase(queue.jobs.begin() + index);
+            queue.deficit -= 1.0;
+
+            // 队列排空的租户退出本轮，额度清零，不能攒着额度日后插队
+            if (queue.jobs.empty()) {
+                level.active.pop_front();
+                level.tenants.erase(tenant);
+            }
+            return job;
+        }
+    }
+    return std::nullopt;
+}
+
+bool FairShareQueue::remove(const std::string& job_id) {
+    for (Level& level : levels_) {
+        for (auto it = level.tenants.begin(); it != level.tenants.end(); ++it) {
+            auto& jobs = it->second.jobs;
+            auto job = std::find_if(jobs.begin(), jobs.end(), [&](const QueuedJob& queued) { return queued.id == job_id; });
+            if (job == jobs.end()) {
+                continue;
+            }
+
+            jobs.erase(job);
+            if (jobs.empty()) {
+                level.active.erase(std::find(level.active.begin(), level.active.end(), it->first));
+                level.tenants.erase(it);
+            }
+            --size_;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<QueuedJob> FairShareQueue::order() const {
+    // 在副本上模拟出队，代价随队列长度平方增长，调用方应在队列副本上、不持锁时计算
+    std::array<Level, 3> levels = levels_;
+    std::vector<QueuedJob> order;
+    order.reserve(size_);
+    while (std::optional<QueuedJob> next = pop_from(levels)) {
+        order.push_back(std::move(*next));
+    }
+    return order;
+}
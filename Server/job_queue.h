@@ -0,0 +1,90 @@
+#ifndef JOB_QUEUE_H
+#define JOB_QUEUE_H
+
+#include <string>
+#include <deque>
+#include <array>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <functional>
+#include <ctime>
+
+namespace lisa::server {
+
+// 任务优先级，高优先级的任务总是先于低优先级的任务出队
+enum class JobPriority {
+    HIGH,
+    NORMAL,
+    LOW
+};
+
+// 解析优先级名称（high/normal/low），无效时抛出 std::invalid_argument
+JobPriority parse_priority(const std::string& name);
+
+// 排队中的任务，附带出队策略使用的信息，选择时不必查询任务表
+struct QueuedJob {
+    std::string id;
+    double expected_seconds = 0;   // 入队时按历史估计的构建耗时
+    time_t queued_at = 0;          // 入队时间
+};
+
+// 从租户子队列中选出下一个出队任务，返回其下标
+using JobSelector = std::function<size_t(const std::deque<QueuedJob>&)>;
+
+// 公平共享队列：每个优先级内按租户（客户端或仓库）分子队列，子队列之间按权重做差额轮转，
+// 一个租户大量提交不会饿死其他租户。非线程安全，由调用方加锁
+class FairShareQueue {
+public:
+    // tenant_weights 中未列出的租户权重为 1
+    explicit FairShareQueue(std::unordered_map<std::string, double> tenant_weights = {});
+
+    // 入队
+    void push(QueuedJob job, const std::string& tenant, JobPriority priority);
+
+    // 出队下一个任务，队列为空时返回空
+    std::optional<std::string> pop();
+
+    // 移除排队中的任务；不在队列中时返回false
+    bool remove(const std::string& job_id);
+
+    // 设置租户子队列内的出队策略，默认先进先出
+    void set_selector(JobSelector selector) { selector_ = std::move(selector); }
+
+    // 按当前状态推算的完整出队顺序，需要模拟全部出队，不宜在每次入队出队时调用
+    std::vector<QueuedJob> order() const;
+
+    // 指定优先级是否有排队任务
+    bool has_priority(JobPriority priority) const { return !levels_[static_cast<size_t>(priority)].active.empty(); }
+
+    // 排队中的任务数
+    size_t size() const { return size_; }
+
+    // 队列是否为空
+    bool empty() const { return size_ == 0; }
+
+private:
+    // 租户子队列
+    struct TenantQueue {
+        std::deque<QueuedJob> jobs;
+        double deficit = 0;   // 本轮剩余的出队额度
+    };
+
+    // 同一优先级的所有租户
+    struct Level {
+        std::unordered_map<std::string, TenantQueue> tenants;
+        std::deque<std::string> active;   // 有排队任务的租户，队首为当前轮到的租户
+    };
+
+    std::unordered_map<std::string, double> tenant_weights_;
+    JobSelector selector_;
+    std::array<Level, 3> levels_;
+    size_t size_ = 0;
+
+    // 从各优先级中按差额轮转取出下一个任务
+    std::optional<QueuedJob> pop_from(std::array<Level, 3>& levels) const;
+};
+
+} // namespace lisa::server
+
+#endif // JOB_QUEUE_H
@@ -0,0 +1,60 @@
+#include "job_table.h"
+#include <atomic>
+#include <functional>
+
+using namespace lisa::server;
+
+JobTable::JobTable() {
+    for (auto& shard : shards_) {
+        shard.jobs = std::make_shared<const Map>();
+    }
+}
+
+JobTable::Shard& JobTable::shard(const std::string& job_id) {
+    return shards_[std::hash<std::string>{}(job_id) % kShards];
+}
+
+const JobTable::Shard& JobTable::shard(const std::string& job_id) const {
+    return shards_[std::hash<std::string>{}(job_id) % kShards];
+}
+
+JobTable::JobPtr JobTable::find(const std::string& job_id) const {
+    auto jobs = std::atomic_load(&shard(job_id).jobs);
+    auto it = jobs->find(job_id);
+    return it == jobs->end() ? nullptr : it->second;
+}
+
+void JobTable::insert(const std::string& job_id, JobPtr job) {
+    Shard& target = shard(job_id);
+    std::lock_guard<std::mutex> lock(target.write_mutex);
+    auto jobs = std::make_shared<Map>(*std::atomic_load(&target.jobs));
+    (*jobs)[job_id] = std::move(job);
+    std::atomic_store(&target.jobs, std::shared_ptr<const Map>(std::move(jobs)));
+}
+
+JobTable::JobPtr JobTable::erase(const std::string& job_id) {
+    Shard& target = shard(job_id);
+    std::lock_guard<std::mutex> lock(target.write_mutex);
+    auto current = std::atomic_load(&target.jobs);
+    auto it = current->find(job_id);
+    if (it == current->end()) {
+        return nullptr;
+    }
+
+    JobPtr erased = it->second;
+    auto jobs = std::make_shared<Map>(*current);
+    jobs->erase(job_id);
+    std::atomic_store(&target.jobs, std::shared_ptr<const Map>(std::move(jobs)));
+    return erased;
+}
+
+std::vector<JobTable::JobPtr> JobTable::snapshot() const {
+    std::vector<JobPtr> jobs;
+    for (const auto& shard : shards_) {
+        auto current = std::atomic_load(&shard.jobs);
+        for (const auto& entry : *current) {
+            jobs.push_back(entry.second);
+        }
+    }
+    return jobs;
+}
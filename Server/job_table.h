@@ -0,0 +1,57 @@
+#ifndef JOB_TABLE_H
+#define JOB_TABLE_H
+
+#include <string>
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace lisa::server {
+
+struct CompilationJob;
+
+// 并发任务表：按任务ID分片，每个分片发布一份不可变的映射。读取方原子地取得当前版本后直接查找，
+// 不等待任何锁；写入方在所属分片上串行，复制映射、修改后替换，旧版本由仍在读取的一方释放
+class JobTable {
+public:
+    using JobPtr = std::shared_ptr<CompilationJob>;
+
+    JobTable();
+
+    // 禁止拷贝构造和赋值
+    JobTable(const JobTable&) = delete;
+    JobTable& operator=(const JobTable&) = delete;
+
+    // 查找任务，不存在时返回空
+    JobPtr find(const std::string& job_id) const;
+
+    // 加入任务，已存在时替换
+    void insert(const std::string& job_id, JobPtr job);
+
+    // 删除任务，返回被删除的任务
+    JobPtr erase(const std::string& job_id);
+
+    // 所有任务的快照，各分片分别取当前版本
+    std::vector<JobPtr> snapshot() const;
+
+private:
+    static constexpr size_t kShards = 64;
+
+    using Map = std::unordered_map<std::string, JobPtr>;
+
+    struct Shard {
+        std::shared_ptr<const Map> jobs;   // 只通过 std::atomic_load/atomic_store 访问
+        std::mutex write_mutex;            // 串行化本分片的写入
+    };
+
+    std::array<Shard, kShards> shards_;
+
+    Shard& shard(const std::string& job_id);
+    const Shard& shard(const std::string& job_id) const;
+};
+
+} // namespace lisa::server
+
+#endif // JOB_TABLE_H
@@ -0,0 +1,19 @@
+#include "job_trace.h"
+#include <chrono>
+
+using namespace lisa::server;
+
+int64_t JobTrace::now() {
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+void JobTrace::record(const std::string& name, int64_t start_us, int64_t end_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    spans_.push_back({name, start_us, end_us});
+}
+
+std::vector<PhaseSpan> JobTrace::spans() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return spans_;
+}
@@ -0,0 +1,43 @@
+#ifndef JOB_TRACE_H
+#define JOB_TRACE_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+namespace lisa::server {
+
+// 任务的一个阶段
+struct PhaseSpan {
+    std::string name;
+    int64_t start_us;   // Unix 时间(微秒)
+    int64_t end_us;
+};
+
+// 任务阶段记录：获取线程和编译线程先后写入各阶段的起止时间，查询方随时读取
+class JobTrace {
+public:
+    JobTrace() = default;
+
+    // 禁止拷贝构造和赋值
+    JobTrace(const JobTrace&) = delete;
+    JobTrace& operator=(const JobTrace&) = delete;
+
+    // 当前 Unix 时间(微秒)
+    static int64_t now();
+
+    // 记录一个阶段
+    void record(const std::string& name, int64_t start_us, int64_t end_us);
+
+    // 已记录的阶段，按记录先后排列
+    std::vector<PhaseSpan> spans() const;
+
+private:
+    std::vector<PhaseSpan> spans_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace lisa::server
+
+#endif // JOB_TRACE_H
@@ -3,6 +3,7 @@
 #include <sstream>
 #include <iomanip>
 #include <cstdarg>
+#include "metrics.h"
 
 namespace lisa::server {
 
@@ -78,56 +79,52 @@ std::string Logger::format_message(LogLevel level, const std::string& message) {
 
 void Logger::debug(const std::string& message) {
     if (log_level_ > LogLevel::DEBUG) return;
-    std::lock_guard<std::mutex> lock(log_mutex_);
-    std::string formatted = format_message(LogLevel::DEBUG, message);
-    if (log_file_.is_open()) {
-        log_file_ << formatted << std::endl;
-    } else {
-        std::cout << formatted << std::endl;
-    }
+    write(LogLevel::DEBUG, message);
 }
 
 void Logger::info(const std::string& message) {
     if (log_level_ > LogLevel::INFO) return;
-    std::lock_guard<std::mutex> lock(log_mutex_);
-    std::string formatted = format_message(LogLevel::INFO, message);
-    if (log_file_.is_open()) {
-        log_file_ << formatted << std::endl;
-    } else {
-        std::cout << formatted << std::endl;
-    }
+    write(LogLevel::INFO, message);
 }
 
 void Logger::warn(const std::string& message) {
     if (log_level_ > LogLevel::WARNING) return;
-    std::lock_guard<std::mutex> lock(log_mutex_);
-    std::string formatted = format_message(LogLevel::WARNING, message);
-    if (log_file_.is_open()) {
-        log_file_ << formatted << std::endl;
-    } else {
-        std::cerr << formatted << std::endl;
-    }
+    write(LogLevel::WARNING, message);
 }
 
 void Logger::error(const std::string& message) {
     if (log_level_ > LogLevel::ERROR) return;
-    std::lock_guard<std::mutex> lock(log_mutex_);
-    std::string formatted = format_message(LogLevel::ERROR, message);
-    if (log_file_.is_open()) {
-        log_file_ << formatted << std::endl;
-    } else {
-        std::cerr << formatted << std::endl;
-    }
+    write(LogLevel::ERROR, message);
 }
 
 void Logger::fatal(const std::string& message) {
     if (log_level_ > LogLevel::FATAL) return;
+    write(LogLevel::FATAL, message);
+}
+
+void Logger::write(LogLevel level, const std::string& message) {
+    // 按级别计数的句柄只注册一次，之后计数不加锁
+    static const Counter messages[] = {
+        Metrics::counter("lisa_log_messages_total", "Log messages written, by level", {{"level", "debug"}}),
+        Metrics::counter("lisa_log_messages_total", "Log messages written, by level", {{"level", "info"}}),
+        Metrics::counter("lisa_log_messages_total", "Log messages written, by level", {{"level", "warning"}}),
+        Metrics::counter("lisa_log_messages_total", "Log messages written, by level", {{"level", "error"}}),
+        Metrics::counter("lisa_log_messages_total", "Log messages written, by level", {{"level", "fatal"}})
+    };
+    static const Counter dropped =
+        Metrics::counter("lisa_log_dropped_total", "Log messages lost because the log stream failed");
+
     std::lock_guard<std::mutex> lock(log_mutex_);
-    std::string formatted = format_message(LogLevel::FATAL, message);
-    if (log_file_.is_open()) {
-        log_file_ << formatted << std::endl;
-    } else {
-        std::cerr << formatted << std::endl;
+    std::string formatted = format_message(level, message);
+    std::ostream& out = log_file_.is_open() ? static_cast<std::ostream&>(log_file_)
+                                            : (level <= LogLevel::INFO ? std::cout : std::cerr);
+    out << formatted << std::endl;
+    messages[static_cast<size_t>(level)].inc();
+
+    // 写入失败(如磁盘已满)时丢弃该条并恢复流，后续日志继续尝试
+    if (!out) {
+        dropped.inc();
+        out.clear();
     }
 }
 
@@ -42,6 +42,9 @@ private:
     static std::mutex log_mutex_;
     static bool initialized_;
 
+    // 输出一条日志并计数
+    static void write(LogLevel level, const std::string& message);
+
     // 格式化日志消息
     static std::string format_message(LogLevel level, const std::string& message);
 
@@ -1,19 +1,46 @@
 #include <iostream>
+#include <filesystem>
 #include <string>
 #include <thread>
 #include <future>
+#include <unistd.h>
 #include <httplib.h>
 #include <git2.h>
 #include <yaml-cpp/yaml.h>
 #include "server.h"
 #include "git_handler.h"
 #include "compilation_handler.h"
+#include "fetch_pipeline.h"
+#include "result_cache.h"
+#include "compiler_cache.h"
+#include "warm_pool.h"
+#include "unit_compiler.h"
+#include "cluster_router.h"
+#include "prefetch_scheduler.h"
+#include "cache_manager.h"
 #include "config.h"
 #include "logger.h"
 
-using namespace httplib;
+namespace fs = std::filesystem;
 using namespace lisa::server;
 
+namespace {
+
+// 查找编译器包装程序：未配置时使用服务器程序所在目录下的 lisa_cc，找不到时返回空
+std::string find_compiler_wrapper(const Config& config) {
+    std::error_code ec;
+    fs::path wrapper = config.compiler_wrapper();
+    if (wrapper.empty()) {
+        wrapper = fs::read_symlink("/proc/self/exe", ec).parent_path() / "lisa_cc";
+    }
+    if (ec || access(wrapper.c_str(), X_OK) != 0) {
+        return "";
+    }
+    return fs::absolute(wrapper).string();
+}
+
+} // namespace
+
 int main() {
     // 加载服务器配置
     Config config;
@@ -23,9 +50,54 @@ int main() {
     }
 
     // 初始化组件
-    GitHandler git_handler(config.git_repo_path());
-    CompilationHandler compilation_handler(config.build_root_path());
-    Server server(config, git_handler, compilation_handler);
+    GitHandler git_handler(config.git_repo_path(), FetchOptions{config.clone_depth(), config.clone_filter()},
+                           config.fetch_freshness_seconds());
+    CompilationOptions compilation_options;
+    compilation_options.output_head_bytes = config.output_head_bytes();
+    compilation_options.output_tail_bytes = config.output_tail_bytes();
+    compilation_options.core_budget = config.core_budget();
+    compilation_options.tenant_weights = config.tenant_weights();
+    compilation_options.shortest_job_first = config.shortest_job_first();
+    compilation_options.aging_factor = config.aging_factor();
+    if (config.compiler_cache_enabled() || !config.cluster_peers().empty()) {
+        compilation_options.compiler_wrapper = find_compiler_wrapper(config);
+        if (compilation_options.compiler_wrapper.empty()) {
+            Logger::warn("Compiler wrapper lisa_cc not found, compiler cache and distributed compilation disabled");
+        }
+    }
+    if (config.compiler_cache_enabled()) {
+        compilation_options.compiler_cache_path = fs::absolute(config.compiler_cache_path()).string();
+    }
+    compilation_options.remote_peers = config.cluster_peers();
+    compilation_options.remote_compilers = config.cluster_compilers();
+    compilation_options.journal_path = config.journal_path();
+    compilation_options.cgroups = config.cgroups_enabled();
+    compilation_options.cgroup_root = config.cgroup_root();
+    compilation_options.default_limits = config.default_limits();
+    compilation_options.tenant_limits = config.tenant_limits();
+    CompilationHandler compilation_handler(config.build_root_path(), config.max_concurrent_jobs(), compilation_options);
+    ResultCache result_cache(config.result_cache_path());
+    CompilerCache compiler_cache(config.compiler_cache_path());
+    CacheManager cache_manager(config, git_handler, compilation_handler, result_cache, compiler_cache);
+    PrefetchScheduler prefetch_scheduler(git_handler, config.prefetch_interval_seconds(), config.prefetch_top_k(),
+                                         config.prefetch_max_concurrent(), config.prefetch_max_idle_seconds());
+    WarmDirPool warm_pool(git_handler, config.max_warm_dirs());
+    FetchPipeline fetch_pipeline(git_handler, compilation_handler, result_cache, warm_pool, config.max_concurrent_fetches());
+
+    // 上次运行中未完成的任务重新获取代码并排队，镜像仍在，通常无需访问网络
+    for (const auto& job_id : compilation_handler.take_recovered_jobs()) {
+        if (auto job_config = compilation_handler.get_job_config(job_id)) {
+            try {
+                fetch_pipeline.submit(FetchPipeline::make_request(job_id, *job_config, git_handler.default_fetch_options()));
+            } catch (const std::exception& e) {
+                compilation_handler.fail_job(job_id, "Failed to requeue after restart: " + std::string(e.what()));
+            }
+        }
+    }
+    UnitCompiler unit_compiler(config.cluster_compilers(), config.cluster_max_units());
+    ClusterRouter cluster_router(config.cluster_self(), config.cluster_peers(), config.cluster_virtual_nodes(),
+                                 config.cluster_probe_interval_seconds());
+    Server server(config, git_handler, compilation_handler, fetch_pipeline, unit_compiler, cluster_router, cache_manager);
 
     // 设置路由
     Server::set_routes(server);
@@ -0,0 +1,244 @@
+#include "metrics.h"
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace lisa::server;
+
+namespace {
+
+// 每个分片的计数槽位数，所有指标的槽位在注册时分配
+constexpr size_t kMaxSlots = 1024;
+
+// 直方图的和以百万分之一为单位累加
+constexpr double kSumScale = 1e6;
+
+// 线程的计数分片，只由所属线程写入；线程退出时计数并入退休总数，分片清零后留给新线程复用
+struct alignas(64) Shard {
+    std::array<std::atomic<uint64_t>, kMaxSlots> slots{};
+};
+
+// 同名指标的一组序列
+struct Family {
+    std::string name;
+    std::string help;
+    bool histogram;
+    std::vector<double> bounds;
+    std::vector<std::pair<MetricLabels, size_t>> series;   // 标签和起始槽位
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<Family> families;
+    std::vector<std::unique_ptr<Shard>> shards;   // 所有分片，只增不减，总数不超过同时存在的线程数
+    std::vector<Shard*> active;                   // 正被线程使用的分片，抓取时汇总
+    std::vector<Shard*> free;                     // 已清零、等待复用的分片
+    std::array<uint64_t, kMaxSlots> retired{};    // 已退出线程的计数
+    size_t next_slot = 0;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+Shard* acquire_shard() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    Shard* shard = nullptr;
+    if (!reg.free.empty()) {
+        shard = reg.free.back();
+        reg.free.pop_back();
+    } else {
+        reg.shards.push_back(std::make_unique<Shard>());
+        shard = reg.shards.back().get();
+    }
+    reg.active.push_back(shard);
+    return shard;
+}
+
+// 线程当前的分片；分片归还后置空
+thread_local Shard* current_shard = nullptr;
+thread_local bool shard_retired = false;
+
+// 线程退出时归还分片：计数并入退休总数，清零后放入空闲列表，短命线程(如预取线程)不会让分片无限增长
+struct ShardOwner {
+    ~ShardOwner() {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (size_t i = 0; i < reg.next_slot; ++i) {
+            reg.retired[i] += current_shard->slots[i].exchange(0, std::memory_order_relaxed);
+        }
+        reg.active.erase(std::find(reg.active.begin(), reg.active.end(), current_shard));
+        reg.free.push_back(current_shard);
+        current_shard = nullptr;
+        shard_retired = true;
+    }
+};
+
+thread_local ShardOwner shard_owner;
+
+// 查找或注册序列，返回起始槽位
+size_t register_series(const std::string& name, const std::string& help, bool histogram,
+                       const std::vector<double>& bounds, const MetricLabels& labels) {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    auto family = std::find_if(reg.families.begin(), reg.families.end(),
+                               [&](const Family& f) { return f.name == name; });
+    if (family == reg.families.end()) {
+        reg.families.push_back({name, help, histogram, bounds, {}});
+        family = reg.families.end() - 1;
+    } else if (family->histogram != histogram || family->bounds != bounds) {
+        throw std::logic_error("Metric " + name + " registered with a different type or buckets");
+    }
+
+    for (const auto& series : family->series) {
+        if (series.first == labels) {
+            return series.second;
+        }
+    }
+
+    // 直方图占用每个桶(含 +Inf)和观测值之和各一个槽位
+    size_t width = histogram ? bounds.size() + 2 : 1;
+    if (reg.next_slot + width > kMaxSlots) {
+        throw std::logic_error("Too many metric series, cannot register " + name);
+    }
+    size_t slot = reg.next_slot;
+    reg.next_slot += width;
+    family->series.emplace_back(labels, slot);
+    return slot;
+}
+
+std::string escape_label(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// 输出 {a="x",b="y"}，extra 为直方图桶的 le 标签
+std::string format_labels(const MetricLabels& labels, const std::string& extra = "") {
+    std::string text;
+    for (const auto& label : labels) {
+        text += (text.empty() ? "" : ",") + label.first + "=\"" + escape_label(label.second) + "\"";
+    }
+    if (!extra.empty()) {
+        text += (text.empty() ? "" : ",") + extra;
+    }
+    return text.empty() ? "" : "{" + text + "}";
+}
+
+std::string format_number(double value) {
+    std::ostringstream ss;
+    ss << std::setprecision(12) << value;
+    return ss.str();
+}
+
+void write_header(std::ostringstream& out, const std::string& name, const std::string& help, const char* type) {
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " " << type << "\n";
+}
+
+} // namespace
+
+void Counter::inc(uint64_t n) const {
+    Metrics::add(slot_, n);
+}
+
+void Histogram::observe(double value) const {
+    const auto& bounds = *bounds_;
+    size_t bucket = std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+    Metrics::add(slot_ + bucket, 1);
+    Metrics::add(slot_ + bounds.size() + 1, static_cast<uint64_t>(std::max(value, 0.0) * kSumScale));
+}
+
+Counter Metrics::counter(const std::string& name, const std::string& help, const MetricLabels& labels) {
+    return Counter(register_series(name, help, false, {}, labels));
+}
+
+Histogram Metrics::histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds,
+                             const MetricLabels& labels) {
+    if (!std::is_sorted(bounds.begin(), bounds.end())) {
+        throw std::logic_error("Histogram buckets of " + name + " must be ascending");
+    }
+    return Histogram(register_series(name, help, true, bounds, labels),
+                     std::make_shared<const std::vector<double>>(bounds));
+}
+
+void Metrics::add(size_t slot, uint64_t n) {
+    if (current_shard == nullptr) {
+        // 分片已在线程退出时归还（其他线程局部对象的析构中仍可能计数），直接计入退休总数
+        if (shard_retired) {
+            auto& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            reg.retired[slot] += n;
+            return;
+        }
+        current_shard = acquire_shard();
+        (void)&shard_owner;   // 使用线程局部对象，线程退出时才会执行其析构
+    }
+
+    // 槽位只有本线程写入，读改写不需要原子指令；抓取方按原子读取
+    auto& cell = current_shard->slots[slot];
+    cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+std::string Metrics::render(const std::vector<GaugeSample>& gauges) {
+    std::ostringstream out;
+    {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+
+        std::vector<uint64_t> totals(reg.retired.begin(), reg.retired.begin() + reg.next_slot);
+        for (const Shard* shard : reg.active) {
+            for (size_t i = 0; i < totals.size(); ++i) {
+                totals[i] += shard->slots[i].load(std::memory_order_relaxed);
+            }
+        }
+
+        for (const auto& family : reg.families) {
+            write_header(out, family.name, family.help, family.histogram ? "histogram" : "counter");
+            for (const auto& [labels, slot] : family.series) {
+                if (!family.histogram) {
+                    out << family.name << format_labels(labels) << " " << totals[slot] << "\n";
+                    continue;
+                }
+
+                // 桶计数按 Prometheus 约定输出为累计值
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i <= family.bounds.size(); ++i) {
+                    cumulative += totals[slot + i];
+                    std::string le = i < family.bounds.size() ? format_number(family.bounds[i]) : "+Inf";
+                    out << family.name << "_bucket" << format_labels(labels, "le=\"" + le + "\"") << " "
+                        << cumulative << "\n";
+                }
+                double sum = totals[slot + family.bounds.size() + 1] / kSumScale;
+                out << family.name << "_sum" << format_labels(labels) << " " << format_number(sum) << "\n";
+                out << family.name << "_count" << format_labels(labels) << " " << cumulative << "\n";
+            }
+        }
+    }
+
+    // 同名的瞬时值相邻给出，只在名称变化时输出说明
+    for (size_t i = 0; i < gauges.size(); ++i) {
+        const auto& gauge = gauges[i];
+        if (i == 0 || gauges[i - 1].name != gauge.name) {
+            write_header(out, gauge.name, gauge.help, "gauge");
+        }
+        out << gauge.name << format_labels(gauge.labels) << " " << format_number(gauge.value) << "\n";
+    }
+    return out.str();
+}
@@ -0,0 +1,91 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <chrono>
+#include <cstdint>
+
+namespace lisa::server {
+
+// 指标标签，按给定顺序输出
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+// 计数器句柄，注册后可在任意线程无锁累加
+class Counter {
+public:
+    void inc(uint64_t n = 1) const;
+
+private:
+    friend class Metrics;
+    explicit Counter(size_t slot) : slot_(slot) {}
+
+    size_t slot_;
+};
+
+// 直方图句柄，按注册时的桶上界统计观测值
+class Histogram {
+public:
+    void observe(double value) const;
+
+private:
+    friend class Metrics;
+    Histogram(size_t slot, std::shared_ptr<const std::vector<double>> bounds) : slot_(slot), bounds_(std::move(bounds)) {}
+
+    size_t slot_;   // 各桶计数之后是观测值之和(百万分之一单位)
+    std::shared_ptr<const std::vector<double>> bounds_;
+};
+
+// 作用域计时：析构时把经过的秒数记入直方图
+class ScopedTimer {
+public:
+    explicit ScopedTimer(const Histogram& histogram)
+        : histogram_(histogram), started_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        histogram_.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count());
+    }
+
+    // 禁止拷贝构造和赋值
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    const Histogram& histogram_;
+    std::chrono::steady_clock::time_point started_;
+};
+
+// 抓取时读取的瞬时值
+struct GaugeSample {
+    std::string name;
+    std::string help;
+    MetricLabels labels;
+    double value;
+};
+
+// 指标注册表。每个线程写自己的计数分片，热路径上没有锁和共享缓存行；抓取时汇总所有分片。
+// 句柄应注册一次后保存(如函数内静态变量)，注册本身需要加锁
+class Metrics {
+public:
+    // 注册计数器，名称和标签相同时返回已有的句柄
+    static Counter counter(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+
+    // 注册直方图，bounds 为升序的桶上界，名称和标签相同时返回已有的句柄
+    static Histogram histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds,
+                               const MetricLabels& labels = {});
+
+    // 汇总所有分片，与抓取时计算的瞬时值一起按 Prometheus 文本格式输出
+    static std::string render(const std::vector<GaugeSample>& gauges = {});
+
+private:
+    friend class Counter;
+    friend class Histogram;
+
+    // 累加当前线程分片中的计数
+    static void add(size_t slot, uint64_t n);
+};
+
+} // namespace lisa::server
+
+#endif // METRICS_H
@@ -0,0 +1,104 @@
+#include "output_buffer.h"
+#include <algorithm>
+
+using namespace lisa::server;
+
+OutputBuffer::OutputBuffer(size_t head_limit, size_t tail_limit)
+    : head_limit_(head_limit), tail_limit_(tail_limit), tail_(tail_limit) {}
+
+void OutputBuffer::append(const char* data, size_t size) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        total_ += size;
+
+        // 先填满开头部分
+        if (head_.size() < head_limit_) {
+            size_t n = std::min(size, head_limit_ - head_.size());
+            head_.append(data, n);
+            data += n;
+            size -= n;
+        }
+
+        // 其余写入环形缓冲，只保留最后 tail_limit_ 字节
+        if (size > 0 && tail_limit_ > 0) {
+            if (size >= tail_limit_) {
+                data += size - tail_limit_;
+                size = tail_limit_;
+                tail_start_ = 0;
+                tail_size_ = 0;
+            }
+            size_t write_pos = (tail_start_ + tail_size_) % tail_limit_;
+            for (size_t copied = 0; copied < size;) {
+                size_t n = std::min(size - copied, tail_limit_ - write_pos);
+                std::copy(data + copied, data + copied + n, tail_.begin() + write_pos);
+                copied += n;
+                write_pos = (write_pos + n) % tail_limit_;
+            }
+            size_t overflow = tail_size_ + size > tail_limit_ ? tail_size_ + size - tail_limit_ : 0;
+            tail_start_ = (tail_start_ + overflow) % tail_limit_;
+            tail_size_ = std::min(tail_size_ + size, tail_limit_);
+        }
+    }
+    data_condition_.notify_all();
+}
+
+void OutputBuffer::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    data_condition_.notify_all();
+}
+
+std::string OutputBuffer::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::string out = head_;
+    if (tail_offset() > head_.size()) {
+        out += omission_marker(tail_offset() - head_.size());
+    }
+    copy_tail(std::max<uint64_t>(tail_offset(), head_.size()), out);
+    return out;
+}
+
+bool OutputBuffer::read(uint64_t& offset, std::string& out, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    data_condition_.wait_for(lock, timeout, [&] { return offset < total_ || closed_; });
+
+    if (offset >= total_) {
+        return !closed_;
+    }
+
+    if (offset < head_.size()) {
+        out.append(head_, offset, std::string::npos);
+        offset = head_.size();
+    }
+    if (offset < tail_offset()) {
+        out += omission_marker(tail_offset() - offset);
+        offset = tail_offset();
+    }
+    copy_tail(offset, out);
+    offset = total_;
+    return true;
+}
+
+uint64_t OutputBuffer::total_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return total_;
+}
+
+void OutputBuffer::copy_tail(uint64_t offset, std::string& out) const {
+    if (offset >= total_) return;
+
+    // 环形缓冲最多分两段复制
+    size_t skip = static_cast<size_t>(offset - tail_offset());
+    size_t begin = (tail_start_ + skip) % tail_limit_;
+    size_t remaining = tail_size_ - skip;
+    size_t first = std::min(remaining, tail_limit_ - begin);
+    out.append(tail_.data() + begin, first);
+    out.append(tail_.data(), remaining - first);
+}
+
+std::string OutputBuffer::omission_marker(uint64_t omitted) {
+    return "\n[... " + std::to_string(omitted) + " bytes of output omitted ...]\n";
+}
@@ -0,0 +1,60 @@
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+
+namespace lisa::server {
+
+// 有界的构建输出缓冲：保留开头 head_limit 字节和最近 tail_limit 字节，中间部分丢弃。
+// 字节以写入顺序的绝对偏移寻址，读取方可以边写边读。
+class OutputBuffer {
+public:
+    OutputBuffer(size_t head_limit, size_t tail_limit);
+
+    // 追加输出
+    void append(const char* data, size_t size);
+    void append(const std::string& data) { append(data.data(), data.size()); }
+
+    // 标记输出结束，唤醒等待中的读取方
+    void close();
+
+    // 获取保留内容，被丢弃的部分以一行标记代替
+    std::string snapshot() const;
+
+    // 从 offset 开始读取已有输出并推进 offset；没有新数据时最多等待 timeout。
+    // 偏移落在已丢弃区间时插入标记并跳到保留的结尾部分。输出已结束且读完时返回false。
+    bool read(uint64_t& offset, std::string& out, std::chrono::milliseconds timeout);
+
+    // 已写入的总字节数（含被丢弃部分）
+    uint64_t total_bytes() const;
+
+private:
+    size_t head_limit_;
+    size_t tail_limit_;
+    std::string head_;           // 输出开头
+    std::vector<char> tail_;     // 输出结尾的环形缓冲
+    size_t tail_start_ = 0;      // 环形缓冲中最旧字节的下标
+    size_t tail_size_ = 0;       // 环形缓冲中的有效字节数
+    uint64_t total_ = 0;
+    bool closed_ = false;
+    mutable std::mutex mutex_;
+    std::condition_variable data_condition_;
+
+    // 已丢弃区间的结束偏移（即保留结尾部分的起始偏移）
+    uint64_t tail_offset() const { return total_ - tail_size_; }
+
+    // 复制结尾部分中从绝对偏移 offset 开始的内容
+    void copy_tail(uint64_t offset, std::string& out) const;
+
+    // 丢弃区间的提示标记
+    static std::string omission_marker(uint64_t omitted);
+};
+
+} // namespace lisa::server
+
+#endif // OUTPUT_BUFFER_H
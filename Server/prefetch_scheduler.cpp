@@ -0,0 +1,75 @@
+#include "prefetch_scheduler.h"
+#include <vector>
+#include <utility>
+#include <chrono>
+#include <algorithm>
+
+using namespace lisa::server;
+
+PrefetchScheduler::PrefetchScheduler(GitHandler& git_handler, time_t interval_seconds, size_t top_k,
+                                     size_t max_concurrent_fetches, time_t max_idle_seconds)
+    : git_handler_(git_handler),
+      interval_seconds_(interval_seconds),
+      top_k_(top_k),
+      max_concurrent_fetches_(max_concurrent_fetches),
+      max_idle_seconds_(max_idle_seconds),
+      stop_(false) {
+    // 周期或预算为0时不启用预取
+    if (interval_seconds_ > 0 && top_k_ > 0 && max_concurrent_fetches_ > 0) {
+        scheduler_thread_ = std::thread(&PrefetchScheduler::scheduler_thread, this);
+    }
+}
+
+PrefetchScheduler::~PrefetchScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        stop_ = true;
+    }
+    stop_condition_.notify_all();
+
+    if (scheduler_thread_.joinable()) {
+        scheduler_thread_.join();
+    }
+}
+
+void PrefetchScheduler::scheduler_thread() {
+    std::unique_lock<std::mutex> lock(stop_mutex_);
+    while (!stop_condition_.wait_for(lock, std::chrono::seconds(interval_seconds_), [this] { return stop_; })) {
+        lock.unlock();
+        run_round();
+        lock.lock();
+    }
+}
+
+void PrefetchScheduler::run_round() {
+    // 展开为 (仓库, 分支) 任务列表
+    std::vector<std::pair<std::string, std::string>> tasks;
+    for (const auto& target : git_handler_.hot_repos(top_k_, max_idle_seconds_)) {
+        for (const auto& branch : target.branches) {
+            tasks.emplace_back(target.repo_url, branch);
+        }
+    }
+    if (tasks.empty()) return;
+
+    Logger::debug("Prefetching " + std::to_string(tasks.size()) + " branches");
+
+    // 固定数量的线程领取任务，限制同时进行的后台获取
+    std::atomic<size_t> next_task(0);
+    std::vector<std::thread> fetchers;
+    size_t fetcher_count = std::min(max_concurrent_fetches_, tasks.size());
+    for (size_t i = 0; i < fetcher_count; ++i) {
+        fetchers.emplace_back([&]() {
+            for (size_t index = next_task++; index < tasks.size(); index = next_task++) {
+                {
+                    std::lock_guard<std::mutex> lock(stop_mutex_);
+                    if (stop_) return;
+                }
+                git_handler_.prefetch(tasks[index].first, tasks[index].second);
+            }
+        });
+    }
+
+    for (auto& fetcher : fetchers) {
+        fetcher.join();
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef PREFETCH_SCHEDULER_H
+#define PREFETCH_SCHEDULER_H
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "git_handler.h"
+#include "logger.h"
+
+namespace lisa::server {
+
+// 后台预取调度器：定期刷新最热仓库的镜像，使提交到达时只需检出
+class PrefetchScheduler {
+public:
+    PrefetchScheduler(GitHandler& git_handler, time_t interval_seconds, size_t top_k,
+                      size_t max_concurrent_fetches, time_t max_idle_seconds);
+    ~PrefetchScheduler();
+
+    // 禁止拷贝构造和赋值
+    PrefetchScheduler(const PrefetchScheduler&) = delete;
+    PrefetchScheduler& operator=(const PrefetchScheduler&) = delete;
+
+private:
+    GitHandler& git_handler_;
+    time_t interval_seconds_;          // 预取周期(秒)
+    size_t top_k_;                     // 每轮预取的仓库数
+    size_t max_concurrent_fetches_;    // 最大并发后台获取数
+    time_t max_idle_seconds_;          // 空闲超过该时间的仓库不再预取
+    std::thread scheduler_thread_;
+    std::mutex stop_mutex_;
+    std::condition_variable stop_condition_;
+    bool stop_;
+
+    // 调度线程函数
+    void scheduler_thread();
+
+    // 执行一轮预取
+    void run_round();
+};
+
+} // namespace lisa::server
+
+#endif // PREFETCH_SCHEDULER_H
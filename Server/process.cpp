@@ -0,0 +1,179 @@
+#include "process.h"
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+extern char** environ;
+
+using namespace lisa::server;
+
+ChildProcess::~ChildProcess() {
+    // 仍在运行的子进程随对象销毁而终止，避免遗留孤儿构建
+    if (pid_ > 0) {
+        signal_group(SIGKILL);
+        wait();
+    }
+}
+
+ChildProcess::ChildProcess(ChildProcess&& other) noexcept : pid_(other.pid_) {
+    other.pid_ = -1;
+}
+
+ChildProcess& ChildProcess::operator=(ChildProcess&& other) noexcept {
+    if (this != &other) {
+        pid_ = other.pid_;
+        other.pid_ = -1;
+    }
+    return *this;
+}
+
+ChildProcess ChildProcess::spawn(const ProcessSpec& spec) {
+    if (spec.argv.empty()) {
+        throw std::invalid_argument("Empty argv for child process");
+    }
+
+    // fork之后子进程只能调用异步信号安全的函数，所有参数提前准备好
+    std::vector<char*> argv;
+    for (const auto& arg : spec.argv) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    std::vector<char*> envp;
+    for (const auto& var : spec.env) envp.push_back(const_cast<char*>(var.c_str()));
+    envp.push_back(nullptr);
+
+    const char* working_dir = spec.working_dir.empty() ? nullptr : spec.working_dir.c_str();
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : spec.cpus) CPU_SET(cpu, &cpu_set);
+
+    // exec成功时该管道随 O_CLOEXEC 关闭，失败时子进程写回errno
+    int error_pipe[2];
+    if (pipe2(error_pipe, O_CLOEXEC) != 0) {
+        throw std::runtime_error("pipe2 failed: " + std::string(std::strerror(errno)));
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        int fork_errno = errno;
+        close(error_pipe[0]);
+        close(error_pipe[1]);
+        throw std::runtime_error("fork failed: " + std::string(std::strerror(fork_errno)));
+    }
+
+    if (pid == 0) {
+        // 子进程：建立独立进程组，取消时可以整组终止
+        setpgid(0, 0);
+
+        // 恢复默认信号处理，服务器可能忽略了SIGPIPE
+        sigset_t empty_mask;
+        sigemptyset(&empty_mask);
+        sigprocmask(SIG_SETMASK, &empty_mask, nullptr);
+        signal(SIGPIPE, SIG_DFL);
+
+        // CPU亲和性由所有后代进程继承
+        if (!spec.cpus.empty()) {
+            sched_setaffinity(0, sizeof(cpu_set), &cpu_set);
+        }
+
+        if (spec.output_fd >= 0) {
+            dup2(spec.output_fd, STDOUT_FILENO);
+            dup2(spec.output_fd, STDERR_FILENO);
+        }
+        int null_fd = open("/dev/null", O_RDONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDIN_FILENO);
+        }
+
+        // 在 exec 之前加入 cgroup，构建的所有进程都受其限制
+        if (spec.cgroup_fd < 0 || write(spec.cgroup_fd, "0", 1) == 1) {
+            if (working_dir == nullptr || chdir(working_dir) == 0) {
+                execve(argv[0], argv.data(), envp.data());
+            }
+        }
+
+        int child_errno = errno;
+        ssize_t ignored = write(error_pipe[1], &child_errno, sizeof(child_errno));
+        (void)ignored;
+        _exit(127);
+    }
+
+    // 父进程同样设置进程组，消除子进程尚未执行setpgid时的竞态
+    setpgid(pid, pid);
+    close(error_pipe[1]);
+
+    ChildProcess child;
+    child.pid_ = pid;
+
+    int child_errno = 0;
+    ssize_t n;
+    do {
+        n = read(error_pipe[0], &child_errno, sizeof(child_errno));
+    } while (n < 0 && errno == EINTR);
+    close(error_pipe[0]);
+
+    if (n == sizeof(child_errno)) {
+        child.wait();
+        throw std::runtime_error("Failed to execute " + spec.argv[0] + ": " + std::strerror(child_errno));
+    }
+
+    return child;
+}
+
+bool ChildProcess::signal_group(int sig) const {
+    return pid_ > 0 && kill(-pid_, sig) == 0;
+}
+
+void ChildProcess::wait_exit() const {
+    siginfo_t info {};
+    while (pid_ > 0 && waitid(P_PID, pid_, &info, WEXITED | WNOWAIT) < 0 && errno == EINTR) {
+    }
+}
+
+int ChildProcess::wait(ProcessUsage* usage) {
+    int status = 0;
+    struct rusage rusage {};
+    while (pid_ > 0 && wait4(pid_, &status, 0, &rusage) < 0 && errno == EINTR) {
+    }
+    pid_ = -1;
+
+    if (usage != nullptr) {
+        auto seconds = [](const timeval& tv) { return static_cast<double>(tv.tv_sec) + tv.tv_usec / 1e6; };
+        usage->user_cpu_seconds = seconds(rusage.ru_utime);
+        usage->system_cpu_seconds = seconds(rusage.ru_stime);
+        usage->max_rss_bytes = static_cast<uint64_t>(rusage.ru_maxrss) * 1024;
+        usage->voluntary_context_switches = static_cast<uint64_t>(rusage.ru_nvcsw);
+        usage->involuntary_context_switches = static_cast<uint64_t>(rusage.ru_nivcsw);
+    }
+    return status;
+}
+
+std::vector<std::string> lisa::server::make_environment(const std::vector<std::pair<std::string, std::string>>& overrides) {
+    std::vector<std::string> env;
+    for (char** var = environ; var != nullptr && *var != nullptr; ++var) {
+        std::string entry(*var);
+        std::string name = entry.substr(0, entry.find('='));
+
+        bool overridden = false;
+        for (const auto& item : overrides) {
+            if (item.first == name) {
+                overridden = true;
+                break;
+            }
+        }
+        if (!overridden) {
+            env.push_back(std::move(entry));
+        }
+    }
+
+    for (const auto& item : overrides) {
+        env.push_back(item.first + "=" + item.second);
+    }
+    return env;
+}
@@ -0,0 +1,66 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <sys/types.h>
+
+namespace lisa::server {
+
+// 子进程启动参数
+struct ProcessSpec {
+    std::vector<std::string> argv;   // argv[0] 为可执行文件的绝对路径
+    std::vector<std::string> env;    // 完整环境，NAME=value 形式
+    std::string working_dir;         // 工作目录，为空时继承
+    int output_fd = -1;              // 标准输出和标准错误重定向目标，-1 表示继承
+    std::vector<int> cpus;           // 绑定的CPU编号，为空时继承
+    int cgroup_fd = -1;              // 要加入的 cgroup 的 cgroup.procs 描述符，-1 表示继承
+};
+
+// 子进程及其已回收的后代进程的资源用量，由 wait4 返回
+struct ProcessUsage {
+    double user_cpu_seconds = 0;
+    double system_cpu_seconds = 0;
+    uint64_t max_rss_bytes = 0;          // 单个进程的最大常驻内存
+    uint64_t voluntary_context_switches = 0;
+    uint64_t involuntary_context_switches = 0;
+};
+
+// 运行在独立进程组中的子进程，可以整组发送信号
+class ChildProcess {
+public:
+    ChildProcess() = default;
+    ~ChildProcess();
+
+    // 禁止拷贝，允许移动
+    ChildProcess(const ChildProcess&) = delete;
+    ChildProcess& operator=(const ChildProcess&) = delete;
+    ChildProcess(ChildProcess&& other) noexcept;
+    ChildProcess& operator=(ChildProcess&& other) noexcept;
+
+    // 启动子进程，失败时抛出 std::runtime_error（包括exec失败）
+    static ChildProcess spawn(const ProcessSpec& spec);
+
+    // 进程ID，同时也是进程组ID
+    pid_t pid() const { return pid_; }
+
+    // 向整个进程组发送信号
+    bool signal_group(int sig) const;
+
+    // 等待子进程结束但不回收。回收前进程ID和进程组ID不会被复用，仍可安全地向进程组发信号
+    void wait_exit() const;
+
+    // 等待子进程结束，返回 waitpid 的状态值；usage 不为空时写入子进程的资源用量
+    int wait(ProcessUsage* usage = nullptr);
+
+private:
+    pid_t pid_ = -1;
+};
+
+// 以当前进程环境为基础，按 NAME=value 覆盖或追加变量
+std::vector<std::string> make_environment(const std::vector<std::pair<std::string, std::string>>& overrides);
+
+} // namespace lisa::server
+
+#endif // PROCESS_H
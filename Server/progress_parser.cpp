@@ -0,0 +1,120 @@
+#include "progress_parser.h"
+#include <cctype>
+
+using namespace lisa::server;
+
+namespace {
+
+// 从 pos 开始读取十进制数，成功时 pos 移到数字之后
+bool read_number(const std::string& text, size_t& pos, size_t& value) {
+    size_t start = pos;
+    value = 0;
+    while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos]))) {
+        value = value * 10 + static_cast<size_t>(text[pos] - '0');
+        ++pos;
+    }
+    return pos > start;
+}
+
+} // namespace
+
+bool ProgressParser::feed(const char* data, size_t size) {
+    bool changed = false;
+    for (size_t i = 0; i < size; ++i) {
+        char c = data[i];
+        // ninja 在终端上用回车覆盖同一行，同样作为行结束
+        if (c == '\n' || c == '\r') {
+            changed = parse_line() || changed;
+            line_.clear();
+        } else if (line_.size() < kLinePrefix) {
+            line_.push_back(c);
+        }
+    }
+    return changed;
+}
+
+bool ProgressParser::parse_line() {
+    size_t completed = 0;
+    size_t total = 0;
+    int percent = 0;
+
+    if (parse_ninja(completed, total)) {
+        // 构建过程中可能多次调用 ninja（如先构建依赖），总数变化时视为新一轮
+        source_ = Source::NINJA;
+        progress_.units_completed = completed;
+        progress_.units_total = total;
+        progress_.percent = static_cast<int>(completed * 100 / total);
+        return true;
+    }
+    if (source_ == Source::NINJA) {
+        return false;
+    }
+
+    if (parse_cmake(percent)) {
+        // CMake 只给出百分比，步骤数按出现的进度行计数，总数未知
+        if (source_ != Source::CMAKE) {
+            source_ = Source::CMAKE;
+            progress_.units_completed = 0;
+            progress_.units_total = 0;
+        }
+        progress_.percent = percent;
+        ++progress_.units_completed;
+        return true;
+    }
+    if (source_ == Source::CMAKE) {
+        return false;
+    }
+
+    if (parse_make_leaving()) {
+        // 没有更具体的标记时以 make 递归完成的目录数作为完成的步骤数，不推算百分比
+        source_ = Source::MAKE;
+        progress_.units_completed = ++directories_left_;
+        progress_.units_total = 0;
+        return true;
+    }
+    return false;
+}
+
+bool ProgressParser::parse_ninja(size_t& completed, size_t& total) const {
+    size_t pos = 0;
+    if (line_.empty() || line_[pos++] != '[') {
+        return false;
+    }
+    if (!read_number(line_, pos, completed) || pos >= line_.size() || line_[pos++] != '/') {
+        return false;
+    }
+    if (!read_number(line_, pos, total) || pos >= line_.size() || line_[pos] != ']') {
+        return false;
+    }
+    return total > 0 && completed <= total;
+}
+
+bool ProgressParser::parse_cmake(int& percent) const {
+    size_t pos = 0;
+    if (line_.empty() || line_[pos++] != '[') {
+        return false;
+    }
+    while (pos < line_.size() && line_[pos] == ' ') {
+        ++pos;
+    }
+    size_t value = 0;
+    if (!read_number(line_, pos, value) || line_.compare(pos, 2, "%]") != 0 || value > 100) {
+        return false;
+    }
+    percent = static_cast<int>(value);
+    return true;
+}
+
+bool ProgressParser::parse_make_leaving() const {
+    // make、gmake 等，递归层级在方括号中
+    size_t bracket = line_.find('[');
+    if (bracket == std::string::npos || bracket < 4 || line_.compare(bracket - 4, 4, "make") != 0) {
+        return false;
+    }
+    size_t pos = bracket + 1;
+    size_t level = 0;
+    if (!read_number(line_, pos, level)) {
+        return false;
+    }
+    return line_.compare(pos, 10, "]: Leaving") == 0;
+}
@@ -0,0 +1,59 @@
+#ifndef PROGRESS_PARSER_H
+#define PROGRESS_PARSER_H
+
+#include <string>
+#include <cstddef>
+
+namespace lisa::server {
+
+// 从构建输出中解析出的进度
+struct BuildProgress {
+    int percent = -1;            // 完成百分比，未知为 -1
+    size_t units_completed = 0;  // 已完成的构建步骤数
+    size_t units_total = 0;      // 构建步骤总数，0 表示未知
+};
+
+// 构建进度解析器：逐段接收构建输出，识别行首的进度标记——ninja 的 [n/m]、CMake Makefile 生成器的 [ 42%]
+// 和 make 递归的 make[N]: Leaving directory。进度标记只出现在行首，每行只缓存开头几十字节，
+// 已处理的输出不会再次扫描
+class ProgressParser {
+public:
+    // 处理一段输出，进度有变化时返回true
+    bool feed(const char* data, size_t size);
+
+    // 当前进度
+    const BuildProgress& progress() const { return progress_; }
+
+private:
+    // 每行缓存的最大字节数，足以容纳所有进度标记
+    static constexpr size_t kLinePrefix = 48;
+
+    // 进度来源，ninja 的步骤计数最准确，其次是 CMake 的百分比，make 递归只能给出目录数
+    enum class Source {
+        NONE,
+        MAKE,
+        CMAKE,
+        NINJA
+    };
+
+    std::string line_;                 // 当前行的开头
+    BuildProgress progress_;
+    Source source_ = Source::NONE;
+    size_t directories_left_ = 0;      // make 递归离开的目录数
+
+    // 解析一个完整行的开头，进度有变化时返回true
+    bool parse_line();
+
+    // 解析 [n/m]
+    bool parse_ninja(size_t& completed, size_t& total) const;
+
+    // 解析 [ 42%]
+    bool parse_cmake(int& percent) const;
+
+    // 是否为 make[N]: Leaving directory
+    bool parse_make_leaving() const;
+};
+
+} // namespace lisa::server
+
+#endif // PROGRESS_PARSER_H
@@ -0,0 +1,108 @@
+#include "result_cache.h"
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <atomic>
+#include <sys/stat.h>
+#include <utime.h>
+#include "build_key.h"
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+using namespace lisa::server;
+
+ResultCache::ResultCache(const std::string& cache_path) : cache_path_(cache_path) {
+    fs::create_directories(cache_path_);
+}
+
+std::string ResultCache::make_key(const std::string& tree_id, const json& config) {
+    json canonical = canonical_build_config(config);
+    canonical["tree"] = tree_id;
+    return json_hash(canonical);
+}
+
+std::string ResultCache::entry_path(const std::string& key) const {
+    return cache_path_ + "/" + key.substr(0, 2) + "/" + key;
+}
+
+std::optional<CachedResult> ResultCache::lookup(const std::string& key) {
+    std::string path = entry_path(key);
+    std::ifstream meta_file(path + "/result.json");
+    std::ifstream output_file(path + "/output.log", std::ios::binary);
+    if (!meta_file.is_open() || !output_file.is_open()) {
+        return std::nullopt;
+    }
+
+    try {
+        json meta = json::parse(meta_file);
+        CachedResult result;
+        result.exit_code = meta.at("exit_code").get<int>();
+        result.commit_id = meta.value("commit_id", "");
+        result.created_at = meta.value("created_at", static_cast<time_t>(0));
+        result.output.assign(std::istreambuf_iterator<char>(output_file), std::istreambuf_iterator<char>());
+
+        // 刷新修改时间作为LRU的最后使用时间
+        utime((path + "/result.json").c_str(), nullptr);
+        return result;
+    } catch (const std::exception& e) {
+        Logger::warn("Discarding unreadable result cache entry " + key + ": " + e.what());
+        fs::remove_all(path);
+        return std::nullopt;
+    }
+}
+
+void ResultCache::store(const std::string& key, const CachedResult& result) {
+    static std::atomic<uint64_t> sequence(0);
+
+    std::string path = entry_path(key);
+    std::string temp_path = path + ".tmp-" + std::to_string(++sequence);
+
+    try {
+        fs::create_directories(temp_path);
+        {
+            json meta = {
+                {"exit_code", result.exit_code},
+                {"commit_id", result.commit_id},
+                {"created_at", result.created_at}
+            };
+            std::ofstream meta_file(temp_path + "/result.json");
+            meta_file << meta.dump();
+            std::ofstream output_file(temp_path + "/output.log", std::ios::binary);
+            output_file << result.output;
+            if (!meta_file || !output_file) {
+                throw std::runtime_error("write failed");
+            }
+        }
+
+        // 写完整后再改名，读取方不会看到半成品；并发写入时保留先完成的一份
+        std::error_code ec;
+        fs::rename(temp_path, path, ec);
+        if (ec) {
+            fs::remove_all(temp_path);
+        }
+    } catch (const std::exception& e) {
+        Logger::warn("Failed to store result cache entry " + key + ": " + e.what());
+        std::error_code ec;
+        fs::remove_all(temp_path, ec);
+    }
+}
+
+std::vector<CacheEntry> ResultCache::cache_entries() {
+    std::vector<CacheEntry> entries;
+    std::error_code ec;
+    for (const auto& shard : fs::directory_iterator(cache_path_, ec)) {
+        if (!shard.is_directory()) continue;
+        for (const auto& entry : fs::directory_iterator(shard.path(), ec)) {
+            struct stat st;
+            if (stat((entry.path() / "result.json").c_str(), &st) == 0) {
+                entries.push_back({entry.path().string(), st.st_mtime, false});
+            }
+        }
+    }
+    return entries;
+}
+
+bool ResultCache::evict(const std::string& path) {
+    std::error_code ec;
+    return fs::remove_all(path, ec) > 0;
+}
@@ -0,0 +1,50 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <nlohmann/json.hpp>
+#include "cache_entry.h"
+#include "logger.h"
+
+namespace lisa::server {
+
+// 缓存的构建结果
+struct CachedResult {
+    int exit_code;
+    std::string output;
+    std::string commit_id;    // 产生该结果的提交
+    time_t created_at;
+};
+
+// 构建结果缓存：以源码树哈希和规范化构建配置哈希为键，结果保存在磁盘上，重启后仍然有效
+class ResultCache {
+public:
+    explicit ResultCache(const std::string& cache_path);
+
+    // 计算缓存键；只有影响构建结果的配置（构建命令、环境变量、编译器）参与计算
+    static std::string make_key(const std::string& tree_id, const nlohmann::json& config);
+
+    // 查找缓存结果，命中时刷新其最后使用时间
+    std::optional<CachedResult> lookup(const std::string& key);
+
+    // 保存构建结果，已存在时保持原结果
+    void store(const std::string& key, const CachedResult& result);
+
+    // 列出缓存条目
+    std::vector<CacheEntry> cache_entries();
+
+    // 删除缓存条目
+    bool evict(const std::string& path);
+
+private:
+    std::string cache_path_;
+
+    // 缓存条目目录：<cache_path>/<键前两位>/<键>
+    std::string entry_path(const std::string& key) const;
+};
+
+} // namespace lisa::server
+
+#endif // RESULT_CACHE_H
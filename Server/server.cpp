@@ -1,13 +1,79 @@
 #include "server.h"
 #include <sstream>
+#include <chrono>
 #include <nlohmann/json.hpp>
+#include "metrics.h"
 
 using json = nlohmann::json;
 using namespace httplib;
-using namespace lisa::server;
 
-Server::Server(const Config& config, GitHandler& git_handler, CompilationHandler& compilation_handler)
-    : config_(config), git_handler_(git_handler), compilation_handler_(compilation_handler) {}
+namespace lisa::server {
+
+namespace {
+
+// 标记由其他节点转发的请求，接收节点直接在本地处理
+const char* const kForwardedHeader = "X-Lisa-Forwarded";
+
+// 转发请求的超时(秒)
+constexpr time_t kForwardConnectTimeoutSeconds = 2;
+constexpr time_t kForwardReadTimeoutSeconds = 30;
+
+// 把请求原样发送到节点
+httplib::Result proxy_request(const std::string& node, const Request& req, const std::string& self) {
+    Client client("http://" + node);
+    client.set_connection_timeout(kForwardConnectTimeoutSeconds, 0);
+    client.set_read_timeout(kForwardReadTimeoutSeconds, 0);
+
+    Headers headers = {{kForwardedHeader, self}};
+    if (req.method == "POST") {
+        return client.Post(req.path, headers, req.body, req.get_header_value("Content-Type"));
+    }
+    return client.Get(req.path, headers);
+}
+
+// 请求开始处理的时间，由预路由处理器写入、请求日志回调读取，两者在同一连接线程上执行
+thread_local std::chrono::steady_clock::time_point request_started;
+
+Histogram route_histogram(const std::string& route) {
+    return Metrics::histogram("lisa_http_request_duration_seconds", "HTTP request latency, by route",
+                              {0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30},
+                              {{"route", route}});
+}
+
+// 按路由取请求耗时直方图：带任务ID的路径归入同一路由，未知路径归入 other，标签数量固定
+const Histogram& request_duration(const std::string& path) {
+    static const std::vector<std::pair<std::string, Histogram>> exact = {
+        {"/api/submit", route_histogram("/api/submit")},
+        {"/api/compile-unit", route_histogram("/api/compile-unit")},
+        {"/api/stats/fetch", route_histogram("/api/stats/fetch")},
+        {"/api/trace", route_histogram("/api/trace")},
+        {"/api/cluster", route_histogram("/api/cluster")},
+        {"/metrics", route_histogram("/metrics")},
+        {"/health", route_histogram("/health")}
+    };
+    static const std::vector<std::pair<std::string, Histogram>> by_job = {
+        {"/api/status/", route_histogram("/api/status/:id")},
+        {"/api/result/", route_histogram("/api/result/:id")},
+        {"/api/stream/", route_histogram("/api/stream/:id")},
+        {"/api/cancel/", route_histogram("/api/cancel/:id")}
+    };
+    static const Histogram other = route_histogram("other");
+
+    for (const auto& [route, histogram] : exact) {
+        if (path == route) return histogram;
+    }
+    for (const auto& [prefix, histogram] : by_job) {
+        if (path.rfind(prefix, 0) == 0) return histogram;
+    }
+    return other;
+}
+
+} // namespace
+
+Server::Server(const Config& config, GitHandler& git_handler, CompilationHandler& compilation_handler, FetchPipeline& fetch_pipeline,
+               UnitCompiler& unit_compiler, ClusterRouter& cluster_router, CacheManager& cache_manager)
+    : config_(config), git_handler_(git_handler), compilation_handler_(compilation_handler), fetch_pipeline_(fetch_pipeline),
+      unit_compiler_(unit_compiler), cluster_router_(cluster_router), cache_manager_(cache_manager) {}
 
 bool Server::start() {
     return http_server_.listen(config_.host().c_str(), config_.port());
@@ -17,61 +83,222 @@ void Server::set_routes(Server& server) {
     auto& svr = server.http_server_;
     auto& git_handler = server.git_handler_;
     auto& compilation_handler = server.compilation_handler_;
+    auto& fetch_pipeline = server.fetch_pipeline_;
+    auto& unit_compiler = server.unit_compiler_;
+    auto& cluster_router = server.cluster_router_;
+    auto& cache_manager = server.cache_manager_;
+
+    // 统计每个请求的处理耗时，请求日志回调在响应写出后执行，流式输出计入整个传输时间
+    svr.set_pre_routing_handler([](const Request&, Response&) {
+        request_started = std::chrono::steady_clock::now();
+        return httplib::Server::HandlerResponse::Unhandled;
+    });
+    svr.set_logger([](const Request& req, const Response&) {
+        // 请求行无法解析时不经过预路由处理器，没有开始时间
+        if (request_started == std::chrono::steady_clock::time_point{}) return;
+        request_duration(req.path).observe(
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - request_started).count());
+        request_started = {};
+    });
 
     // 提交编译任务
     svr.Post("/api/submit", [&](const Request& req, Response& res) {
-        handle_submit(req, res, git_handler, compilation_handler);
+        if (forward_submit(req, res, cluster_router)) return;
+        handle_submit(req, res, git_handler, compilation_handler, fetch_pipeline);
     });
 
     // 查询编译状态
-    svr.Get("/api/status/(:job_id)", [&](const Request& req, Response& res) {
+    svr.Get(R"(/api/status/([^/]+))", [&](const Request& req, Response& res) {
+        if (forward_job_request(req, res, compilation_handler, cluster_router)) return;
         handle_status(req, res, compilation_handler);
     });
 
     // 获取编译结果
-    svr.Get("/api/result/(:job_id)", [&](const Request& req, Response& res) {
+    svr.Get(R"(/api/result/([^/]+))", [&](const Request& req, Response& res) {
+        if (forward_job_request(req, res, compilation_handler, cluster_router)) return;
         handle_result(req, res, compilation_handler);
     });
 
+    // 实时读取构建输出
+    svr.Get(R"(/api/stream/([^/]+))", [&](const Request& req, Response& res) {
+        if (forward_job_request(req, res, compilation_handler, cluster_router)) return;
+        handle_stream(req, res, compilation_handler);
+    });
+
+    // 取消编译任务
+    svr.Post(R"(/api/cancel/([^/]+))", [&](const Request& req, Response& res) {
+        if (forward_job_request(req, res, compilation_handler, cluster_router)) return;
+        handle_cancel(req, res, compilation_handler);
+    });
+
+    // 编译其他节点发来的预处理单元
+    svr.Post("/api/compile-unit", [&](const Request& req, Response& res) {
+        handle_compile_unit(req, res, unit_compiler);
+    });
+
+    // 代码获取统计
+    svr.Get("/api/stats/fetch", [&](const Request&, Response& res) {
+        FetchStats stats = git_handler.fetch_stats();
+        double hit_rate = stats.requests > 0 ? static_cast<double>(stats.served_locally) / stats.requests : 0.0;
+        json response_data = {
+            {"requests", stats.requests},
+            {"served_locally", stats.served_locally},
+            {"hit_rate", hit_rate},
+            {"prefetches", stats.prefetches},
+            {"prefetch_failures", stats.prefetch_failures}
+        };
+        res.status = 200;
+        res.set_content(response_data.dump(), "application/json");
+    });
+
+    // 任务阶段时间线
+    svr.Get("/api/trace", [&](const Request& req, Response& res) {
+        handle_trace(req, res, compilation_handler);
+    });
+
+    // 集群节点状态
+    svr.Get("/api/cluster", [&](const Request&, Response& res) {
+        json nodes = json::array();
+        for (const auto& node : cluster_router.nodes()) {
+            nodes.push_back({
+                {"address", node.address},
+                {"healthy", node.healthy},
+                {"self", node.self},
+                {"checked_at", node.checked_at}
+            });
+        }
+        json response_data = {
+            {"routing", cluster_router.enabled()},
+            {"nodes", nodes}
+        };
+        res.status = 200;
+        res.set_content(response_data.dump(), "application/json");
+    });
+
     // 健康检查
-    svr.Get("/health", [](const Request& req, Response& res) {
+    svr.Get("/health", [](const Request&, Response& res) {
         res.status = 200;
         res.set_content("OK", "text/plain");
     });
+
+    // Prometheus 指标
+    svr.Get("/metrics", [&](const Request& req, Response& res) {
+        handle_metrics(req, res, compilation_handler, cache_manager);
+    });
 }
 
-void Server::handle_submit(const Request& req, Response& res, GitHandler& git_handler, CompilationHandler& compilation_handler) {
+bool Server::forward_submit(const Request& req, Response& res, ClusterRouter& cluster_router) {
+    // 转发来的请求总在本地处理，避免节点之间对环的看法不一致时来回转发
+    if (!cluster_router.enabled() || req.has_header(kForwardedHeader)) {
+        return false;
+    }
+
+    std::string repo_url;
     try {
-        if (req.headers.find("Content-Type") == req.headers.end() || 
-            req.headers["Content-Type"] != "application/json") {
+        repo_url = json::parse(req.body).at("repo_url").get<std::string>();
+    } catch (const json::exception&) {
+        // 格式错误由本地处理并报告
+        return false;
+    }
+
+    // 依次尝试环上的节点，轮到本节点时在本地处理
+    for (const auto& node : cluster_router.candidates(repo_url)) {
+        if (node == cluster_router.self()) {
+            return false;
+        }
+
+        auto response = proxy_request(node, req, cluster_router.self());
+        if (!response) {
+            cluster_router.mark_down(node);
+            continue;
+        }
+
+        if (response->status == 202) {
+            try {
+                cluster_router.remember_job(json::parse(response->body).at("job_id").get<std::string>(), node);
+            } catch (const json::exception&) {
+                Logger::warn("Node " + node + " accepted a job without a job ID");
+            }
+        }
+        Logger::info("Forwarded submission for " + repo_url + " to " + node);
+        res.status = response->status;
+        res.set_header("X-Lisa-Node", node);
+        res.set_content(response->body, response->get_header_value("Content-Type"));
+        return true;
+    }
+    return false;
+}
+
+bool Server::forward_job_request(const Request& req, Response& res, CompilationHandler& compilation_handler,
+                                 ClusterRouter& cluster_router) {
+    std::string job_id = req.matches[1];
+    if (compilation_handler.has_job(job_id)) {
+        return false;
+    }
+    auto node = cluster_router.job_node(job_id);
+    if (!node) {
+        return false;
+    }
+
+    // 流式输出可能持续整个构建，让客户端直接连接任务所在的节点
+    if (req.path.rfind("/api/stream/", 0) == 0) {
+        res.status = 307;
+        res.set_header("Location", "http://" + *node + req.path);
+        return true;
+    }
+
+    auto response = proxy_request(*node, req, cluster_router.self());
+    if (!response) {
+        cluster_router.mark_down(*node);
+        res.status = 502;
+        res.set_content("Node " + *node + " is unreachable", "text/plain");
+        return true;
+    }
+    res.status = response->status;
+    res.set_header("X-Lisa-Node", *node);
+    res.set_content(response->body, response->get_header_value("Content-Type"));
+    return true;
+}
+
+void Server::handle_submit(const Request& req, Response& res, GitHandler& git_handler,
+                           CompilationHandler& compilation_handler, FetchPipeline& fetch_pipeline) {
+    try {
+        if (req.get_header_value("Content-Type").rfind("application/json", 0) != 0) {
             res.status = 400;
             res.set_content("Invalid Content-Type. Expected application/json", "text/plain");
             return;
         }
 
         json req_data = json::parse(req.body);
-        std::string repo_url = req_data["repo_url"];
-        std::string branch = req_data.value("branch", "main");
-        std::string commit_hash = req_data.value("commit_hash", "");
+        FetchRequest fetch_request = FetchPipeline::make_request("", req_data, git_handler.default_fetch_options());
+        GitHandler::validate_fetch_options(fetch_request.options);
 
-        // 克隆或拉取代码
-        std::string repo_path = git_handler.clone_or_pull(repo_url, branch, commit_hash);
+        // 调度优先级：high、normal、low，租户未指定时按仓库划分
+        parse_priority(req_data.value("priority", "normal"));
 
-        // 创建编译任务
-        std::string job_id = compilation_handler.create_job(repo_path, req_data);
+        // 先创建任务再异步获取代码，提交请求不等待网络
+        std::string job_id = compilation_handler.create_fetching_job(req_data);
+        fetch_request.job_id = job_id;
+        fetch_pipeline.submit(std::move(fetch_request));
+
+        static const Counter submits = Metrics::counter("lisa_submits_total", "Compilation jobs accepted by this node");
+        submits.inc();
 
         // 返回任务ID
         json response_data = {
-            {"status", "success"},
+            {"status", "accepted"},
             {"job_id", job_id},
-            {"message", "Compilation job created successfully"}
+            {"message", "Compilation job accepted, fetching sources"}
         };
 
-        res.status = 201;
+        res.status = 202;
         res.set_content(response_data.dump(), "application/json");
     } catch (const json::exception& e) {
         res.status = 400;
         res.set_content("Invalid JSON format: " + std::string(e.what()), "text/plain");
+    } catch (const std::invalid_argument& e) {
+        res.status = 400;
+        res.set_content("Invalid request: " + std::string(e.what()), "text/plain");
     } catch (const std::exception& e) {
         res.status = 500;
         res.set_content("Server error: " + std::string(e.what()), "text/plain");
@@ -93,11 +320,37 @@ void Server::handle_status(const Request& req, Response& res, CompilationHandler
             {"job_id", job_id},
             {"status", status->status},
             {"progress", status->progress},
-            {"started_at", status->started_at}
+            {"started_at", status->started_at},
+            {"paused_seconds", status->paused_seconds}
         };
 
         if (status->completed) {
             response_data["completed_at"] = status->completed_at;
+            response_data["cached"] = status->cached;
+        }
+        if (status->units_completed) {
+            response_data["units_completed"] = *status->units_completed;
+        }
+        if (status->units_total) {
+            response_data["units_total"] = *status->units_total;
+        }
+        if (status->queue_position) {
+            response_data["queue_position"] = *status->queue_position;
+        }
+        if (status->estimated_wait_seconds) {
+            response_data["estimated_wait_seconds"] = *status->estimated_wait_seconds;
+        }
+        if (status->estimated_duration_seconds) {
+            response_data["estimated_duration_seconds"] = *status->estimated_duration_seconds;
+        }
+        if (status->estimated_duration_p90_seconds) {
+            response_data["estimated_duration_p90_seconds"] = *status->estimated_duration_p90_seconds;
+        }
+        if (status->eta) {
+            response_data["eta"] = *status->eta;
+        }
+        if (status->eta_p90) {
+            response_data["eta_p90"] = *status->eta_p90;
         }
 
         res.status = 200;
@@ -108,6 +361,56 @@ void Server::handle_status(const Request& req, Response& res, CompilationHandler
     }
 }
 
+void Server::handle_stream(const Request& req, Response& res, CompilationHandler& compilation_handler) {
+    std::string job_id = req.matches[1];
+    auto output = compilation_handler.get_job_output(job_id);
+    if (!output) {
+        res.status = 404;
+        res.set_content("Job not found", "text/plain");
+        return;
+    }
+
+    // 分块传输：每次送出已有的新输出，没有新输出时短暂等待，构建结束后关闭连接
+    auto offset = std::make_shared<uint64_t>(0);
+    res.status = 200;
+    res.set_chunked_content_provider("text/plain", [output, offset](size_t, DataSink& sink) {
+        std::string chunk;
+        if (!output->read(*offset, chunk, std::chrono::milliseconds(1000))) {
+            sink.done();
+            return true;
+        }
+        return chunk.empty() || sink.write(chunk.data(), chunk.size());
+    });
+}
+
+void Server::handle_cancel(const Request& req, Response& res, CompilationHandler& compilation_handler) {
+    try {
+        std::string job_id = req.matches[1];
+        if (!compilation_handler.has_job(job_id)) {
+            res.status = 404;
+            res.set_content("Job not found", "text/plain");
+            return;
+        }
+
+        if (!compilation_handler.cancel_job(job_id)) {
+            res.status = 409;
+            res.set_content("Job already finished", "text/plain");
+            return;
+        }
+
+        json response_data = {
+            {"job_id", job_id},
+            {"status", "cancelled"}
+        };
+
+        res.status = 200;
+        res.set_content(response_data.dump(), "application/json");
+    } catch (const std::exception& e) {
+        res.status = 500;
+        res.set_content("Server error: " + std::string(e.what()), "text/plain");
+    }
+}
+
 void Server::handle_result(const Request& req, Response& res, CompilationHandler& compilation_handler) {
     try {
         std::string job_id = req.matches[1];
@@ -130,8 +433,36 @@ void Server::handle_result(const Request& req, Response& res, CompilationHandler
             {"status", result->status},
             {"exit_code", result->exit_code},
             {"output", result->output},
-            {"completed_at", result->completed_at}
+            {"completed_at", result->completed_at},
+            {"cached", result->cached}
         };
+        if (result->rusage) {
+            response_data["rusage"] = {
+                {"user_cpu_seconds", result->rusage->user_cpu_seconds},
+                {"system_cpu_seconds", result->rusage->system_cpu_seconds},
+                {"max_rss_bytes", result->rusage->max_rss_bytes},
+                {"voluntary_context_switches", result->rusage->voluntary_context_switches},
+                {"involuntary_context_switches", result->rusage->involuntary_context_switches}
+            };
+        }
+        json phases = json::array();
+        for (const auto& phase : result->phases) {
+            phases.push_back({
+                {"name", phase.name},
+                {"start_us", phase.start_us},
+                {"duration_us", phase.end_us - phase.start_us}
+            });
+        }
+        response_data["phases"] = phases;
+        if (result->usage) {
+            response_data["resources"] = {
+                {"memory_peak_bytes", result->usage->memory_peak_bytes},
+                {"cpu_seconds", result->usage->cpu_seconds},
+                {"io_read_bytes", result->usage->io_read_bytes},
+                {"io_write_bytes", result->usage->io_write_bytes},
+                {"oom_kills", result->usage->oom_kills}
+            };
+        }
 
         res.status = 200;
         res.set_content(response_data.dump(), "application/json");
@@ -139,4 +470,129 @@ void Server::handle_result(const Request& req, Response& res, CompilationHandler
         res.status = 500;
         res.set_content("Server error: " + std::string(e.what()), "text/plain");
     }
-}
\ No newline at end of file
+}
+
+void Server::handle_trace(const Request& req, Response& res, CompilationHandler& compilation_handler) {
+    try {
+        // from 和 to 为 Unix 时间(秒)，默认为最近一小时
+        auto seconds_param = [&req](const std::string& name, int64_t default_value) {
+            if (!req.has_param(name)) {
+                return default_value;
+            }
+            std::string value = req.get_param_value(name);
+            if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos || value.size() > 12) {
+                throw std::invalid_argument(name + " must be a Unix timestamp in seconds");
+            }
+            return static_cast<int64_t>(std::stoll(value));
+        };
+        int64_t now = JobTrace::now() / 1000000;
+        int64_t to = seconds_param("to", now);
+        int64_t from = seconds_param("from", to - 3600);
+        if (from > to) {
+            throw std::invalid_argument("from must not be later than to");
+        }
+
+        // 每个任务一行，阶段为完整事件
+        json events = json::array();
+        int64_t tid = 0;
+        for (const auto& trace : compilation_handler.get_job_traces(from * 1000000, to * 1000000 + 999999)) {
+            ++tid;
+            events.push_back({
+                {"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", tid},
+                {"args", {{"name", trace.job_id}}}
+            });
+            for (const auto& phase : trace.phases) {
+                events.push_back({
+                    {"name", phase.name}, {"cat", "job"}, {"ph", "X"}, {"pid", 1}, {"tid", tid},
+                    {"ts", phase.start_us}, {"dur", phase.end_us - phase.start_us},
+                    {"args", {{"job_id", trace.job_id}}}
+                });
+            }
+        }
+
+        json response_data = {
+            {"traceEvents", events},
+            {"displayTimeUnit", "ms"}
+        };
+        res.status = 200;
+        res.set_content(response_data.dump(), "application/json");
+    } catch (const std::invalid_argument& e) {
+        res.status = 400;
+        res.set_content("Invalid request: " + std::string(e.what()), "text/plain");
+    } catch (const std::exception& e) {
+        res.status = 500;
+        res.set_content("Server error: " + std::string(e.what()), "text/plain");
+    }
+}
+
+void Server::handle_metrics(const Request&, Response& res, CompilationHandler& compilation_handler,
+                            CacheManager& cache_manager) {
+    // 计数器和直方图由各线程分片汇总，队列和缓存占用在抓取时读取
+    std::vector<GaugeSample> gauges = {
+        {"lisa_queued_jobs", "Jobs waiting in the compilation queue", {},
+         static_cast<double>(compilation_handler.queued_job_count())},
+        {"lisa_running_jobs", "Jobs currently building", {},
+         static_cast<double>(compilation_handler.running_job_count())}
+    };
+    auto usage = cache_manager.usage();
+    for (const auto& cache : usage) {
+        gauges.push_back({"lisa_cache_bytes", "Bytes on disk per cache, as of the last janitor pass",
+                          {{"cache", cache.name}}, static_cast<double>(cache.bytes)});
+    }
+    for (const auto& cache : usage) {
+        gauges.push_back({"lisa_cache_entries", "Entries per cache, as of the last janitor pass",
+                          {{"cache", cache.name}}, static_cast<double>(cache.entries)});
+    }
+
+    res.status = 200;
+    res.set_content(Metrics::render(gauges), "text/plain; version=0.0.4");
+}
+
+void Server::handle_compile_unit(const Request& req, Response& res, UnitCompiler& unit_compiler) {
+    try {
+        if (!req.is_multipart_form_data() || !req.has_file("source")) {
+            res.status = 400;
+            res.set_content("Invalid request: expected multipart form with a source field", "text/plain");
+            return;
+        }
+
+        CompileUnitRequest request;
+        request.compiler = req.get_file_value("compiler").content;
+        request.version = req.get_file_value("version").content;
+        request.language = req.get_file_value("language").content;
+        request.args = json::parse(req.get_file_value("args").content).get<std::vector<std::string>>();
+        request.working_dir = req.get_file_value("working_dir").content;
+        request.source = req.get_file_value("source").content;
+
+        // 编译器版本不一致时生成的目标文件可能不兼容，由发起方在本地编译
+        if (request.version != unit_compiler.compiler_version(request.compiler)) {
+            res.status = 409;
+            res.set_content("Compiler version mismatch", "text/plain");
+            return;
+        }
+
+        auto result = unit_compiler.compile(request);
+        if (!result) {
+            res.status = 503;
+            res.set_content("Too many compile units in progress", "text/plain");
+            return;
+        }
+
+        // 响应体依次为诊断输出和目标文件
+        res.status = 200;
+        res.set_header("X-Lisa-Exit-Code", std::to_string(result->exit_code));
+        res.set_header("X-Lisa-Diagnostics-Length", std::to_string(result->diagnostics.size()));
+        res.set_content(result->diagnostics + result->object, "application/octet-stream");
+    } catch (const json::exception& e) {
+        res.status = 400;
+        res.set_content("Invalid JSON format: " + std::string(e.what()), "text/plain");
+    } catch (const std::invalid_argument& e) {
+        res.status = 400;
+        res.set_content("Invalid request: " + std::string(e.what()), "text/plain");
+    } catch (const std::exception& e) {
+        res.status = 500;
+        res.set_content("Server error: " + std::string(e.what()), "text/plain");
+    }
+}
+
+} // namespace lisa::server
@@ -7,13 +7,18 @@
 #include "config.h"
 #include "git_handler.h"
 #include "compilation_handler.h"
+#include "fetch_pipeline.h"
+#include "unit_compiler.h"
+#include "cluster_router.h"
+#include "cache_manager.h"
 #include "logger.h"
 
 namespace lisa::server {
 
 class Server {
 public:
-    Server(const Config& config, GitHandler& git_handler, CompilationHandler& compilation_handler);
+    Server(const Config& config, GitHandler& git_handler, CompilationHandler& compilation_handler, FetchPipeline& fetch_pipeline,
+           UnitCompiler& unit_compiler, ClusterRouter& cluster_router, CacheManager& cache_manager);
     ~Server() = default;
 
     // 禁止拷贝构造和赋值
@@ -24,27 +29,52 @@ public:
     bool start();
 
     // 设置HTTP路由
-    static void set_routes(httplib::Server& http_server, GitHandler& git_handler, CompilationHandler& compilation_handler);
+    static void set_routes(Server& server);
 
 private:
     Config config_;
     httplib::Server http_server_;
     GitHandler& git_handler_;
     CompilationHandler& compilation_handler_;
+    FetchPipeline& fetch_pipeline_;
+    UnitCompiler& unit_compiler_;
+    ClusterRouter& cluster_router_;
+    CacheManager& cache_manager_;
+
+    // 把提交请求转发到仓库所在的节点，已转发时返回true，应在本节点处理时返回false
+    static bool forward_submit(const httplib::Request& req, httplib::Response& res, ClusterRouter& cluster_router);
+
+    // 把任务请求转发到任务所在的节点，本节点的任务或未知任务返回false
+    static bool forward_job_request(const httplib::Request& req, httplib::Response& res,
+                                    CompilationHandler& compilation_handler, ClusterRouter& cluster_router);
 
     // 处理代码提交请求
-    static void handle_submit(httplib::Server& svr, const httplib::Request& req, httplib::Response& res, GitHandler& git_handler);
+    static void handle_submit(const httplib::Request& req, httplib::Response& res, GitHandler& git_handler,
+                              CompilationHandler& compilation_handler, FetchPipeline& fetch_pipeline);
 
     // 处理编译状态查询请求
-    static void handle_status(httplib::Server& svr, const httplib::Request& req, httplib::Response& res, CompilationHandler& compilation_handler);
+    static void handle_status(const httplib::Request& req, httplib::Response& res, CompilationHandler& compilation_handler);
+
+    // 处理构建输出流式读取请求
+    static void handle_stream(const httplib::Request& req, httplib::Response& res, CompilationHandler& compilation_handler);
+
+    // 处理取消任务请求
+    static void handle_cancel(const httplib::Request& req, httplib::Response& res, CompilationHandler& compilation_handler);
 
     // 处理编译结果获取请求
-    static void handle_result(httplib::Server& svr, const httplib::Request& req, httplib::Response& res, CompilationHandler& compilation_handler);
+    static void handle_result(const httplib::Request& req, httplib::Response& res, CompilationHandler& compilation_handler);
+
+    // 导出时间范围内任务的阶段记录，格式为 Chrome trace event JSON
+    static void handle_trace(const httplib::Request& req, httplib::Response& res, CompilationHandler& compilation_handler);
+
+    // 以 Prometheus 文本格式导出指标
+    static void handle_metrics(const httplib::Request& req, httplib::Response& res, CompilationHandler& compilation_handler,
+                               CacheManager& cache_manager);
 
-    // 处理健康检查请求
-    static void handle_health(httplib::Server& svr, const httplib::Request& req, httplib::Response& res);
+    // 处理其他节点发来的编译单元
+    static void handle_compile_unit(const httplib::Request& req, httplib::Response& res, UnitCompiler& unit_compiler);
 };
 
 } // namespace lisa::server
 
-#endif // SERVER_H
\ No newline at end of file
+#endif // SERVER_H
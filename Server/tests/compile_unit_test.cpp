@@ -0,0 +1,80 @@
+// /api/compile-unit 的参数检查：读写调用方指定的文件或加载代码的参数必须被拒绝。
+// 处理器把 UnitCompiler::compile 抛出的 std::invalid_argument 作为 400 返回
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "compile_unit.h"
+#include "unit_compiler.h"
+
+using namespace lisa::server;
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, const std::string& message) {
+    if (!condition) {
+        std::cerr << "FAILED: " << message << std::endl;
+        ++failures;
+    }
+}
+
+// 请求是否以 400 被拒绝
+bool rejected(UnitCompiler& compiler, const std::vector<std::string>& args) {
+    CompileUnitRequest request;
+    request.compiler = "cc";
+    request.language = "c";
+    request.args = args;
+    request.source = "int main(void) { return 0; }\n";
+    try {
+        compiler.compile(request);
+    } catch (const std::invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+int main() {
+    UnitCompiler compiler({"cc"}, 1);
+
+    const std::vector<std::string> denied = {
+        "-fpass-plugin=/tmp/evil.so",
+        "-fplugin=/tmp/evil.so",
+        "-fopt-info-vec=/tmp/out",
+        "-fopt-info",
+        "-ftime-trace=/tmp/out.json",
+        "-ftime-trace",
+        "-foptimization-record-file=/tmp/out.yaml",
+        "-fsave-optimization-record",
+        "-fprofile-use=/tmp/profile",
+        "-ftest-coverage",
+        "-fdump-tree-all",
+        "-fcrash-diagnostics-dir=/tmp",
+        "-fsanitize-ignorelist=/etc/passwd",
+        "-fsome-future-option=/tmp/out",
+        "-Wl,-rpath,/tmp",
+        "-Wa,-adhln=/tmp/out",
+        "-I/etc",
+        "-o"
+    };
+    for (const auto& arg : denied) {
+        expect(!remote_args_allowed({arg}), "remote_args_allowed accepted " + arg);
+        expect(rejected(compiler, {"-O2", arg}), "compile-unit accepted " + arg);
+    }
+
+    const std::vector<std::string> allowed = {
+        "-O2", "-g", "-fPIC", "-fno-exceptions", "-fstack-protector-strong", "-fvisibility=hidden",
+        "-fdiagnostics-color=always", "-ffile-prefix-map=/src=.", "-fsanitize=address", "-march=native",
+        "-std=c++17", "-Wall", "-Werror=return-type"
+    };
+    expect(remote_args_allowed(allowed), "remote_args_allowed rejected code-generation flags");
+    expect(remote_args_allowed({"--param", "max-inline-insns-single=100"}), "remote_args_allowed rejected --param");
+
+    if (failures == 0) {
+        std::cout << "compile_unit_test passed" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
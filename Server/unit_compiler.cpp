@@ -0,0 +1,154 @@
+#include "unit_compiler.h"
+#include "process.h"
+#include <stdexcept>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace fs = std::filesystem;
+using namespace lisa::server;
+
+UnitCompiler::UnitCompiler(const std::vector<std::string>& allowed_compilers, size_t max_concurrent)
+    : allowed_compilers_(allowed_compilers.begin(), allowed_compilers.end()), max_concurrent_(max_concurrent) {}
+
+std::string UnitCompiler::resolve(const std::string& compiler) const {
+    // 只接受允许列表中的名称，不接受路径
+    if (compiler.find('/') != std::string::npos || allowed_compilers_.count(compiler) == 0) {
+        throw std::invalid_argument("Compiler not allowed: " + compiler);
+    }
+    std::string path = find_program(compiler);
+    if (path.empty()) {
+        throw std::invalid_argument("Compiler not found: " + compiler);
+    }
+    return path;
+}
+
+std::string UnitCompiler::compiler_version(const std::string& compiler) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = versions_.find(compiler);
+        if (it != versions_.end()) {
+            return it->second;
+        }
+    }
+
+    std::string output;
+    if (run({resolve(compiler), "--version"}, "", output) != 0) {
+        throw std::invalid_argument("Failed to query compiler version: " + compiler);
+    }
+    std::string version = output.substr(0, output.find('\n'));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    versions_[compiler] = version;
+    return version;
+}
+
+std::optional<CompileUnitResult> UnitCompiler::compile(const CompileUnitRequest& request) {
+    if (request.language != "c" && request.language != "c++") {
+        throw std::invalid_argument("Unsupported language: " + request.language);
+    }
+    if (!remote_args_allowed(request.args)) {
+        throw std::invalid_argument("Compile arguments are not allowed");
+    }
+    std::string compiler = resolve(request.compiler);
+
+    // 超出并发上限时立即拒绝，发起方退回本地编译，而不是在这里排队
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_ >= max_concurrent_) {
+            return std::nullopt;
+        }
+        ++running_;
+    }
+    struct SlotGuard {
+        UnitCompiler& owner;
+        ~SlotGuard() {
+            std::lock_guard<std::mutex> lock(owner.mutex_);
+            --owner.running_;
+        }
+    } slot{*this};
+
+    std::string temp_template = (fs::temp_directory_path() / "lisa-unit-XXXXXX").string();
+    if (mkdtemp(temp_template.data()) == nullptr) {
+        throw std::runtime_error("Failed to create unit directory");
+    }
+    const std::string& unit_dir = temp_template;
+
+    CompileUnitResult result;
+    try {
+        // 扩展名告诉编译器输入已经预处理过
+        std::string source_name = request.language == "c" ? "unit.i" : "unit.ii";
+        {
+            std::ofstream source(unit_dir + "/" + source_name, std::ios::binary);
+            source << request.source;
+            if (!source) {
+                throw std::runtime_error("Failed to write unit source");
+            }
+        }
+
+        std::vector<std::string> argv = {compiler};
+        argv.insert(argv.end(), request.args.begin(), request.args.end());
+        if (!request.working_dir.empty()) {
+            argv.push_back("-fdebug-prefix-map=" + unit_dir + "=" + request.working_dir);
+        }
+        argv.insert(argv.end(), {"-c", source_name, "-o", "unit.o"});
+
+        result.exit_code = run(argv, unit_dir, result.diagnostics);
+        if (result.exit_code == 0) {
+            std::ifstream object(unit_dir + "/unit.o", std::ios::binary);
+            result.object.assign(std::istreambuf_iterator<char>(object), std::istreambuf_iterator<char>());
+        }
+    } catch (...) {
+        std::error_code ec;
+        fs::remove_all(unit_dir, ec);
+        throw;
+    }
+
+    std::error_code ec;
+    fs::remove_all(unit_dir, ec);
+    return result;
+}
+
+int UnitCompiler::run(const std::vector<std::string>& argv, const std::string& working_dir, std::string& output) {
+    int output_pipe[2];
+    if (pipe2(output_pipe, O_CLOEXEC) != 0) {
+        throw std::runtime_error("Failed to create output pipe");
+    }
+
+    ProcessSpec spec;
+    spec.argv = argv;
+    spec.env = make_environment({});
+    spec.working_dir = working_dir;
+    spec.output_fd = output_pipe[1];
+
+    ChildProcess child;
+    try {
+        child = ChildProcess::spawn(spec);
+    } catch (...) {
+        close(output_pipe[0]);
+        close(output_pipe[1]);
+        throw;
+    }
+    close(output_pipe[1]);
+
+    char chunk[16384];
+    for (;;) {
+        ssize_t n = read(output_pipe[0], chunk, sizeof(chunk));
+        if (n > 0) {
+            output.append(chunk, static_cast<size_t>(n));
+        } else if (n == 0 || errno != EINTR) {
+            break;
+        }
+    }
+    close(output_pipe[0]);
+
+    int status = child.wait();
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return -1;
+}
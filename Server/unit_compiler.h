@@ -0,0 +1,45 @@
+#ifndef UNIT_COMPILER_H
+#define UNIT_COMPILER_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <optional>
+#include <unordered_map>
+#include <mutex>
+#include "compile_unit.h"
+
+namespace lisa::server {
+
+// 编译单元执行器：在临时目录中编译其他节点发来的预处理单元，只使用允许列表中的编译器
+class UnitCompiler {
+public:
+    UnitCompiler(const std::vector<std::string>& allowed_compilers, size_t max_concurrent);
+
+    // 禁止拷贝构造和赋值
+    UnitCompiler(const UnitCompiler&) = delete;
+    UnitCompiler& operator=(const UnitCompiler&) = delete;
+
+    // 获取本机编译器 --version 输出的第一行，编译器不允许或找不到时抛出 std::invalid_argument
+    std::string compiler_version(const std::string& compiler);
+
+    // 编译单元，并发编译数已满时返回空；请求不合法时抛出 std::invalid_argument
+    std::optional<CompileUnitResult> compile(const CompileUnitRequest& request);
+
+private:
+    std::set<std::string> allowed_compilers_;
+    size_t max_concurrent_;
+    size_t running_ = 0;
+    std::unordered_map<std::string, std::string> versions_;   // 编译器名称 -> 版本
+    std::mutex mutex_;
+
+    // 在 PATH 中查找允许的编译器
+    std::string resolve(const std::string& compiler) const;
+
+    // 运行命令，返回退出码并收集输出
+    static int run(const std::vector<std::string>& argv, const std::string& working_dir, std::string& output);
+};
+
+} // namespace lisa::server
+
+#endif // UNIT_COMPILER_H
@@ -0,0 +1,92 @@
+#include "warm_pool.h"
+#include <chrono>
+#include "build_key.h"
+
+using json = nlohmann::json;
+using namespace lisa::server;
+
+WarmDirPool::WarmDirPool(GitHandler& git_handler, size_t max_dirs)
+    : git_handler_(git_handler), max_dirs_(max_dirs) {
+}
+
+std::string WarmDirPool::make_key(const std::string& repo_url, const std::string& branch, const json& config) {
+    json canonical = canonical_build_config(config);
+    canonical["repo_url"] = repo_url;
+    canonical["branch"] = branch;
+    return json_hash(canonical);
+}
+
+std::optional<std::string> WarmDirPool::acquire(const std::string& key, const std::string& repo_url,
+                                                const std::string& commit_id) {
+    if (max_dirs_ == 0) {
+        return std::nullopt;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = dirs_.find(key);
+        if (it != dirs_.end() && it->second.leased) {
+            return std::nullopt;
+        }
+        if (it == dirs_.end()) {
+            if (dirs_.size() >= max_dirs_ && !evict_one()) {
+                return std::nullopt;
+            }
+            it = dirs_.emplace(key, WarmDir{}).first;
+        }
+        it->second.leased = true;
+        it->second.last_used = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    }
+
+    // 检出可能较慢，在锁外进行；租用标记保证同一目录不会被并发检出
+    try {
+        std::string path = git_handler_.warm_worktree(repo_url, key, commit_id);
+        std::lock_guard<std::mutex> lock(mutex_);
+        dirs_[key].path = path;
+        return path;
+    } catch (const std::exception& e) {
+        Logger::warn("Failed to prepare warm directory for " + repo_url + ": " + e.what());
+        std::lock_guard<std::mutex> lock(mutex_);
+        dirs_.erase(key);
+        return std::nullopt;
+    }
+}
+
+void WarmDirPool::release(const std::string& path, bool discard) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = dirs_.begin();
+        while (it != dirs_.end() && it->second.path != path) {
+            ++it;
+        }
+        if (it == dirs_.end()) {
+            return;
+        }
+        if (!discard) {
+            it->second.leased = false;
+            it->second.last_used = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+            return;
+        }
+        dirs_.erase(it);
+    }
+
+    Logger::info("Discarding warm directory: " + path);
+    git_handler_.release_checkout(path);
+}
+
+bool WarmDirPool::evict_one() {
+    auto victim = dirs_.end();
+    for (auto it = dirs_.begin(); it != dirs_.end(); ++it) {
+        if (!it->second.leased && (victim == dirs_.end() || it->second.last_used < victim->second.last_used)) {
+            victim = it;
+        }
+    }
+    if (victim == dirs_.end()) {
+        return false;
+    }
+
+    Logger::info("Evicting warm directory: " + victim->second.path);
+    git_handler_.release_checkout(victim->second.path);
+    dirs_.erase(victim);
+    return true;
+}
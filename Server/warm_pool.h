@@ -0,0 +1,52 @@
+#ifndef WARM_POOL_H
+#define WARM_POOL_H
+
+#include <string>
+#include <optional>
+#include <unordered_map>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include "git_handler.h"
+#include "logger.h"
+
+namespace lisa::server {
+
+// 热构建目录池：按 (仓库, 分支, 构建配置) 保留构建目录及其中的目标文件和构建系统状态，
+// 同一键的新任务检出新提交后在原目录中增量构建。每个目录同一时间只租给一个任务
+class WarmDirPool {
+public:
+    WarmDirPool(GitHandler& git_handler, size_t max_dirs);
+
+    // 禁止拷贝构造和赋值
+    WarmDirPool(const WarmDirPool&) = delete;
+    WarmDirPool& operator=(const WarmDirPool&) = delete;
+
+    // 计算热目录键，只有影响构建结果的配置参与计算
+    static std::string make_key(const std::string& repo_url, const std::string& branch, const nlohmann::json& config);
+
+    // 租用热目录并检出指定提交；目录正被占用、池已满或检出失败时返回空，调用方改为全新构建
+    std::optional<std::string> acquire(const std::string& key, const std::string& repo_url, const std::string& commit_id);
+
+    // 归还租用；discard 为true时删除目录，用于构建被中途终止、状态不可信的情况
+    void release(const std::string& path, bool discard);
+
+private:
+    // 热目录记录
+    struct WarmDir {
+        std::string path;
+        time_t last_used = 0;
+        bool leased = false;
+    };
+
+    GitHandler& git_handler_;
+    size_t max_dirs_;
+    std::unordered_map<std::string, WarmDir> dirs_;   // 键 -> 热目录
+    std::mutex mutex_;
+
+    // 淘汰最久未用的空闲目录，调用方须持有 mutex_；没有可淘汰的目录时返回false
+    bool evict_one();
+};
+
+} // namespace lisa::server
+
+#endif // WARM_POOL_H
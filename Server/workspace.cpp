@@ -0,0 +1,127 @@
+#include "workspace.h"
+#include <filesystem>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+namespace fs = std::filesystem;
+using namespace lisa::server;
+
+namespace {
+
+// 文件系统不支持克隆时的错误码
+bool reflink_unsupported(int error) {
+    return error == EOPNOTSUPP || error == ENOTTY || error == EXDEV || error == EINVAL || error == ENOSYS;
+}
+
+// 尝试以写时复制方式克隆文件，文件系统不支持时返回false
+bool reflink_file(const fs::path& source, const fs::path& target, mode_t mode) {
+#ifdef FICLONE
+    int source_fd = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (source_fd < 0) {
+        throw std::runtime_error("Failed to open " + source.string() + ": " + std::strerror(errno));
+    }
+    int target_fd = open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+    if (target_fd < 0) {
+        int open_errno = errno;
+        close(source_fd);
+        throw std::runtime_error("Failed to create " + target.string() + ": " + std::strerror(open_errno));
+    }
+
+    int result = ioctl(target_fd, FICLONE, source_fd);
+    int clone_errno = errno;
+    close(source_fd);
+    close(target_fd);
+    if (result == 0) {
+        // 克隆出的文件是独立副本，恢复写权限，构建可以直接修改
+        chmod(target.c_str(), mode | S_IWUSR);
+        return true;
+    }
+
+    unlink(target.c_str());
+    if (!reflink_unsupported(clone_errno)) {
+        throw std::runtime_error("Failed to clone " + source.string() + ": " + std::strerror(clone_errno));
+    }
+#else
+    (void)source;
+    (void)target;
+    (void)mode;
+#endif
+    return false;
+}
+
+} // namespace
+
+PopulateMethod lisa::server::populate_workspace(const std::string& source_path, const std::string& target_path) {
+    fs::create_directories(target_path);
+
+    // 一次克隆失败后整棵树都不再尝试，避免每个文件多一次系统调用
+    bool try_reflink = true;
+    // root 不受权限位限制，去掉写权限挡不住原地写入，以 root 运行时不使用硬链接
+    bool try_hardlink = geteuid() != 0;
+    PopulateMethod used = PopulateMethod::REFLINK;
+
+    for (auto it = fs::recursive_directory_iterator(source_path); it != fs::recursive_directory_iterator(); ++it) {
+        const fs::path& source = it->path();
+        fs::path target = fs::path(target_path) / source.lexically_relative(source_path);
+
+        struct stat st;
+        if (lstat(source.c_str(), &st) != 0) {
+            throw std::runtime_error("Failed to stat " + source.string() + ": " + std::strerror(errno));
+        }
+
+        // 目录总是新建，构建新产生的文件只出现在任务自己的工作目录中
+        if (S_ISDIR(st.st_mode)) {
+            fs::create_directory(target);
+            continue;
+        }
+        if (S_ISLNK(st.st_mode)) {
+            fs::copy_symlink(source, target);
+            continue;
+        }
+        if (!S_ISREG(st.st_mode)) {
+            continue;
+        }
+
+        if (try_reflink) {
+            if (reflink_file(source, target, st.st_mode & 07777)) {
+                continue;
+            }
+            try_reflink = false;
+        }
+
+        // 硬链接与快照及其他任务共享同一inode，只靠去掉的写权限防止原地写入：构建以 root 运行、
+        // 先 chmod 再写、或 touch 修改时间戳时都会影响共享的文件。以改名方式替换文件的工具不受影响
+        if (try_hardlink) {
+            if (link(source.c_str(), target.c_str()) == 0) {
+                used = std::max(used, PopulateMethod::HARDLINK);
+                continue;
+            }
+            if (errno != EXDEV && errno != EMLINK && errno != EPERM) {
+                throw std::runtime_error("Failed to link " + source.string() + ": " + std::strerror(errno));
+            }
+            try_hardlink = false;
+        }
+
+        fs::copy_file(source, target);
+        fs::permissions(target, fs::perms::owner_write, fs::perm_options::add);
+        used = PopulateMethod::COPY;
+    }
+
+    return used;
+}
+
+const char* lisa::server::populate_method_name(PopulateMethod method) {
+    switch (method) {
+        case PopulateMethod::REFLINK: return "reflink";
+        case PopulateMethod::HARDLINK: return "hardlink";
+        case PopulateMethod::COPY: return "copy";
+    }
+    return "unknown";
+}
@@ -0,0 +1,24 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include <string>
+
+namespace lisa::server {
+
+// 工作目录的填充方式，按开销从低到高排列
+enum class PopulateMethod {
+    REFLINK,    // 写时复制克隆，文件系统支持 FICLONE 时使用
+    HARDLINK,   // 硬链接到只读的源文件
+    COPY        // 完整复制
+};
+
+// 以源目录为模板填充任务独立的工作目录：目录结构总是新建，文件优先写时复制克隆，
+// 不支持时回退为硬链接(以 root 运行时跳过)，跨文件系统时回退为复制。返回实际用到的开销最高的方式
+PopulateMethod populate_workspace(const std::string& source_path, const std::string& target_path);
+
+// 填充方式的名称，用于日志
+const char* populate_method_name(PopulateMethod method);
+
+} // namespace lisa::server
+
+#endif // WORKSPACE_H